@@ -0,0 +1,339 @@
+// Throughput of the ingestion and accumulation hot paths, over sizes from a
+// single hop up to a million bins. Nothing here needs a device or a display.
+// The DSP kernels use the best instruction set of the CPU, run again with
+// RTLPOWERGUI_DSP_ISA=scalar (or SSE2, AVX2) to compare against the others.
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+#include "DspKernels.h"
+#include "PlotBuilder.h"
+
+// Bins per hop of the sweeps below, smaller sweeps are a single hop
+static constexpr int hop_bins = 1024;
+
+// Exposes the text hop assembly without running anything
+class TextFeeder : public SpectrumSource
+{
+public:
+	void feed(std::string_view line) { process_text_line(line); }
+
+	SourceKind get_kind() override { return SourceKind::rtl_power_fftw; }
+	void launch() override {}
+	void request_stop() override {}
+	bool reap() override { return true; }
+	bool get_exec_status() override { return true; }
+	double get_bytes_per_second() override { return 0.0; }
+	double get_lines_per_second() override { return 0.0; }
+};
+
+// A sweep of the given total bins starting at 100 MHz, in hops of up to hop_bins
+static Settings make_settings(size_t bins)
+{
+	Settings s{};
+	s.nbins = std::min(bins, (size_t)hop_bins);
+	s.samp_rate = 2e6;
+	s.min_freq = 100.0f;
+	s.max_freq = 100.0f + (bins / s.nbins) * 2.0f;
+	s.min_freq_units = 2;
+	s.max_freq_units = 2;
+	s.gain = 0;
+	s.percent = 0;
+	s.nsamples = 20;
+	return s;
+}
+
+static Measurement make_measurement(size_t bins)
+{
+	Measurement m;
+	m.settings = make_settings(bins);
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(-60.0, 1.0);
+	for(std::vector<double>* series : {&m.spectrum, &m.average, &m.max, &m.min})
+	{
+		series->resize(bins);
+		for(double& v : *series)
+		{
+			v = noise(rng);
+		}
+	}
+	return m;
+}
+
+// Readouts of every hop of the sweep, as rtl_power_fftw would produce them
+static std::vector<Scan> make_scans(size_t bins)
+{
+	Measurement m = make_measurement(bins);
+	size_t nbins = m.settings.nbins;
+	std::vector<Scan> scans(bins / nbins);
+	for(size_t h = 0; h < scans.size(); h++)
+	{
+		Scan& sc = scans[h];
+		sc.reads.resize(nbins);
+		for(size_t i = 0; i < nbins; i++)
+		{
+			sc.reads[i].freq = m.get_bin_center_freq(h * nbins + i);
+			sc.reads[i].power = m.spectrum[h * nbins + i];
+		}
+		sc.is_first_of_scan = h == 0;
+		sc.is_last_of_scan = h + 1 == scans.size();
+		sc.device = 0;
+		sc.is_partial = false;
+	}
+	return scans;
+}
+
+// One readout per line, formatted like rtl_power_fftw does
+static std::vector<std::string> make_readout_lines(size_t bins)
+{
+	Measurement m = make_measurement(bins);
+	std::vector<std::string> lines(bins);
+	char line[64];
+	for(size_t i = 0; i < bins; i++)
+	{
+		std::snprintf(line, sizeof(line), "%.6e %.3f\n", m.get_bin_center_freq(i), m.spectrum[i]);
+		lines[i] = line;
+	}
+	return lines;
+}
+
+// Every size up to a million bins, and every history whose memory stays reasonable
+static void sizes_and_histories(benchmark::internal::Benchmark* b)
+{
+	for(int64_t bins = 256; bins <= (1 << 20); bins *= 16)
+	{
+		for(int64_t history : {1, 10, 100, 1000})
+		{
+			if(bins * history <= (1 << 24))
+			{
+				b->Args({bins, history});
+			}
+		}
+	}
+}
+
+static void BM_ProcessTextLine(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	std::vector<Scan> scans = make_scans(bins);
+
+	// One sweep of text, split in lines beforehand like PipeReader hands them out
+	std::string text;
+	char line[64];
+	for(const Scan& sc : scans)
+	{
+		text += "# rtl-power-fftw output\n";
+		for(const Readout& r : sc.reads)
+		{
+			std::snprintf(line, sizeof(line), "%.6e %.3f\n", r.freq, r.power);
+			text += line;
+		}
+		text += sc.is_last_of_scan ? "\n\n" : "\n";
+	}
+	std::vector<std::string_view> lines;
+	for(size_t start = 0; start < text.size();)
+	{
+		size_t end = text.find('\n', start) + 1;
+		lines.emplace_back(text.data() + start, end - start);
+		start = end;
+	}
+
+	TextFeeder feeder;
+	RTLPowerData hop;
+	for(auto _ : state)
+	{
+		for(std::string_view l : lines)
+		{
+			feeder.feed(l);
+		}
+		while(feeder.hops.pop_swap(hop)) {}
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ProcessTextLine)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+static void BM_ParseReadout(benchmark::State& state)
+{
+	std::vector<std::string> lines = make_readout_lines(state.range(0));
+	for(auto _ : state)
+	{
+		for(const std::string& l : lines)
+		{
+			Readout read{};
+			benchmark::DoNotOptimize(parse_readout(l, read));
+			benchmark::DoNotOptimize(read);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_ParseReadout)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+// How lines were parsed before parse_readout, for comparison
+static void BM_ParseStringstream(benchmark::State& state)
+{
+	std::vector<std::string> lines = make_readout_lines(state.range(0));
+	for(auto _ : state)
+	{
+		for(const std::string& l : lines)
+		{
+			Readout read{};
+			std::stringstream s{l};
+			s >> read.freq >> read.power;
+			benchmark::DoNotOptimize(read);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_ParseStringstream)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+static void BM_Accumulate(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	PlotBuilder pb;
+	pb.exposed = make_settings(bins);
+	pb.commit_settings();
+	pb.averaging.history = state.range(1);
+	pb.update_averaging();
+	pb.apply_pending();
+
+	std::vector<Scan> scans = make_scans(bins);
+	for(auto _ : state)
+	{
+		for(const Scan& sc : scans)
+		{
+			pb.accumulate(sc);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+}
+BENCHMARK(BM_Accumulate)->Apply(sizes_and_histories);
+
+// Handing the accumulated measurement from the worker to the GUI thread
+static void BM_PublishUpdate(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	PlotBuilder pb;
+	pb.exposed = make_settings(bins);
+	pb.commit_settings();
+	pb.apply_pending();
+
+	for(auto _ : state)
+	{
+		pb.publish();
+		pb.update();
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+}
+BENCHMARK(BM_PublishUpdate)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+static void BM_ToCsv(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	Measurement m = make_measurement(bins);
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(m.to_csv());
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+}
+BENCHMARK(BM_ToCsv)->RangeMultiplier(16)->Range(256, 1 << 20)->Unit(benchmark::kMillisecond);
+
+static void BM_FromBinFileRaw(benchmark::State& state)
+{
+	constexpr int scans = 16;
+	size_t bins = state.range(0);
+
+	char fname[] = "/tmp/rtlpowergui-bench-XXXXXX";
+	int fd = mkstemp(fname);
+	if(fd == -1)
+	{
+		state.SkipWithError("Unable to create a temporary file");
+		return;
+	}
+	Measurement m = make_measurement(bins);
+	std::vector<float> row(m.spectrum.begin(), m.spectrum.end());
+	for(int s = 0; s < scans; s++)
+	{
+		if(write(fd, row.data(), row.size() * sizeof(float)) != (ssize_t)(row.size() * sizeof(float)))
+		{
+			state.SkipWithError("Unable to write the temporary file");
+		}
+	}
+	close(fd);
+
+	// It logs every scan it loads
+	std::stringstream discard;
+	std::streambuf* cout_buf = std::cout.rdbuf(discard.rdbuf());
+	for(auto _ : state)
+	{
+		m.numScans = scans;
+		m.settings.nbins = bins;
+		Measurement::from_binFile_raw(fname, m);
+		discard.str("");
+	}
+	std::cout.rdbuf(cout_buf);
+	unlink(fname);
+	state.SetItemsProcessed(state.iterations() * bins * scans);
+}
+BENCHMARK(BM_FromBinFileRaw)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+static void BM_GetBinForFreq(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	Measurement m = make_measurement(bins);
+	std::vector<double> freqs(bins);
+	for(size_t i = 0; i < bins; i++)
+	{
+		freqs[i] = m.get_bin_center_freq(i) + 1.0;
+	}
+
+	for(auto _ : state)
+	{
+		size_t sum = 0;
+		for(double f : freqs)
+		{
+			sum += m.get_bin_for_freq(f);
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+}
+BENCHMARK(BM_GetBinForFreq)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+// The per-range kernels finishing every hop, see RTLPOWERGUI_DSP_ISA above
+static void BM_DspSubtract(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	Measurement m = make_measurement(bins);
+	std::vector<double> out(bins);
+	for(auto _ : state)
+	{
+		dsp::subtract(out.data(), m.spectrum.data(), m.average.data(), bins);
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+	state.SetLabel(dsp::get_isa_name());
+}
+BENCHMARK(BM_DspSubtract)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+static void BM_DspLinearToDb(benchmark::State& state)
+{
+	size_t bins = state.range(0);
+	Measurement m = make_measurement(bins);
+	std::vector<double> linear(bins), out(bins);
+	dsp::db_to_linear(linear.data(), m.spectrum.data(), bins);
+	for(auto _ : state)
+	{
+		dsp::linear_to_db(out.data(), linear.data(), bins);
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * bins);
+	state.SetLabel(dsp::get_isa_name());
+}
+BENCHMARK(BM_DspLinearToDb)->RangeMultiplier(16)->Range(256, 1 << 20);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,464 @@
+// Runs PlotBuilder without any display, for unattended monitoring stations.
+// Settings come from the command line (--key value) and / or a file of
+// "key value" lines given with --config, later ones overriding earlier ones.
+// It periodically writes the accumulated spectrum as CSV, and can record every
+// sweep as a .bin/.met pair which the GUI imports and the replay source plays back.
+//
+// Keys:
+//	range MIN:MAX		in Hertz, k / M / G suffixes allowed (88M:108M)
+//	bins N				per hop
+//	gain DB
+//	overlap PERCENT
+//	samples N			FFTs averaged per hop
+//	rate HZ				sample rate
+//	devices LIST		comma separated indices or serials, sweeping in parallel
+//	source KIND			rtl_power_fftw (default), direct, replay or synthetic
+//	command CMD			run instead of rtl_power_fftw
+//	binary				read rtl_power_fftw's matrix output instead of text
+//	iq FILE				IQ file for the direct source
+//	replay FILE			recording for the replay source
+//	tones LIST			comma separated MHz for the synthetic source
+//	hop-rate N			hops per second of the replay and synthetic sources
+//	adaptive N			revisit busy segments N times between full sweeps
+//	history N			averaged sweeps, 0 to disable averaging
+//	exponential TC		exponential averaging with this time constant instead
+//	linear				average linear power instead of dB
+//	snapshot FILE		CSV of the spectrum, average, max and min, rewritten every interval
+//	record BASENAME		append every sweep to BASENAME.bin, described by BASENAME.met
+//	latency FILE		latency histograms, rewritten every interval. Draw and Total
+//						end when the snapshot is written, so they need one
+//	interval SECONDS	between snapshots, 10 by default
+//	duration SECONDS	quit after this long, 0 (default) runs until SIGINT / SIGTERM
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "DspKernels.h"
+#include "PlotBuilder.h"
+
+struct DaemonOptions
+{
+	std::string snapshot;
+	std::string record;
+	std::string latency;
+	double interval = 10.0;
+	double duration = 0.0;
+};
+
+static std::atomic<bool> quit(false);
+
+static void on_signal(int)
+{
+	quit = true;
+}
+
+static void usage()
+{
+	std::cerr << "Usage: rtlpowergui_daemon [--config FILE] --range MIN:MAX [--key value]...\n"
+			  << "See daemon/DaemonMain.cpp for every key." << std::endl;
+}
+
+// "100", "2.5k", "88M", "1.2G" in Hertz
+static bool parse_hertz(const std::string& str, double& out)
+{
+	char* end;
+	out = std::strtod(str.c_str(), &end);
+	if(end == str.c_str())
+	{
+		return false;
+	}
+	switch(*end)
+	{
+	case 'k': out *= 1e3; end++; break;
+	case 'M': out *= 1e6; end++; break;
+	case 'G': out *= 1e9; end++; break;
+	default: break;
+	}
+	return *end == '\0';
+}
+
+static bool copy_string(char* dst, size_t size, const std::string& value)
+{
+	if(value.size() >= size)
+	{
+		return false;
+	}
+	std::strcpy(dst, value.c_str());
+	return true;
+}
+
+static bool apply_option(const std::string& key, const std::string& value, PlotBuilder& pb, DaemonOptions& opt)
+{
+	Settings& s = pb.exposed;
+	if(key == "range")
+	{
+		size_t colon = value.find(':');
+		double low, high;
+		if(colon == std::string::npos || !parse_hertz(value.substr(0, colon), low) ||
+			!parse_hertz(value.substr(colon + 1), high) || high <= low)
+		{
+			return false;
+		}
+		s.min_freq = low / 1e6;
+		s.max_freq = high / 1e6;
+		s.min_freq_units = 2;
+		s.max_freq_units = 2;
+	}
+	else if(key == "bins")
+		s.nbins = std::stoi(value);
+	else if(key == "gain")
+		s.gain = std::stof(value);
+	else if(key == "overlap")
+		s.percent = std::stoi(value);
+	else if(key == "samples")
+		s.nsamples = std::stoi(value);
+	else if(key == "rate")
+	{
+		double rate;
+		if(!parse_hertz(value, rate))
+			return false;
+		s.samp_rate = rate;
+	}
+	else if(key == "devices")
+		return copy_string(pb.devices, sizeof(pb.devices), value);
+	else if(key == "source")
+	{
+		if(value == "rtl_power_fftw")
+			pb.source_kind = SourceKind::rtl_power_fftw;
+		else if(value == "direct")
+			pb.source_kind = SourceKind::direct;
+		else if(value == "replay")
+			pb.source_kind = SourceKind::replay;
+		else if(value == "synthetic")
+			pb.source_kind = SourceKind::synthetic;
+		else
+			return false;
+	}
+	else if(key == "command")
+		return copy_string(pb.power_command, sizeof(pb.power_command), value);
+	else if(key == "binary")
+		pb.binary_transfer = true;
+	else if(key == "iq")
+		return copy_string(pb.iq_file, sizeof(pb.iq_file), value);
+	else if(key == "replay")
+		return copy_string(pb.replay_file, sizeof(pb.replay_file), value);
+	else if(key == "tones")
+		return copy_string(pb.tones, sizeof(pb.tones), value);
+	else if(key == "hop-rate")
+		pb.hop_rate = std::stof(value);
+	else if(key == "adaptive")
+	{
+		pb.adaptive_sweep = true;
+		pb.adaptive_revisits = std::stoi(value);
+	}
+	else if(key == "history")
+	{
+		pb.averaging.mode = 0;
+		pb.averaging.history = std::stoi(value);
+	}
+	else if(key == "exponential")
+	{
+		pb.averaging.mode = 1;
+		pb.averaging.time_constant = std::stof(value);
+	}
+	else if(key == "linear")
+		pb.averaging.linear = true;
+	else if(key == "snapshot")
+		opt.snapshot = value;
+	else if(key == "record")
+		opt.record = value;
+	else if(key == "latency")
+		opt.latency = value;
+	else if(key == "interval")
+		opt.interval = std::stod(value);
+	else if(key == "duration")
+		opt.duration = std::stod(value);
+	else
+		return false;
+	return true;
+}
+
+static bool is_flag(const std::string& key)
+{
+	return key == "binary" || key == "linear";
+}
+
+static bool apply_checked(const std::string& key, const std::string& value, PlotBuilder& pb, DaemonOptions& opt)
+{
+	bool ok;
+	try
+	{
+		ok = apply_option(key, value, pb, opt);
+	}
+	catch(const std::exception&)
+	{
+		ok = false;
+	}
+	if(!ok)
+	{
+		std::cerr << "Invalid option " << key << " " << value << std::endl;
+	}
+	return ok;
+}
+
+static bool load_config(const std::string& fname, PlotBuilder& pb, DaemonOptions& opt)
+{
+	std::ifstream f(fname);
+	if(!f.good())
+	{
+		std::cerr << "Cannot open config file " << fname << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while(std::getline(f, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::stringstream ss(line);
+		std::string key, value;
+		if(!(ss >> key))
+		{
+			continue;
+		}
+		// The rest of the line, commands have spaces
+		std::getline(ss >> std::ws, value);
+		value.erase(value.find_last_not_of(" \t\r") + 1);
+		if(!apply_checked(key, value, pb, opt))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool parse_args(int argc, char** argv, PlotBuilder& pb, DaemonOptions& opt)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg.rfind("--", 0) != 0)
+		{
+			std::cerr << "Unexpected argument " << arg << std::endl;
+			return false;
+		}
+		std::string key = arg.substr(2);
+		std::string value;
+		if(!is_flag(key))
+		{
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << arg << std::endl;
+				return false;
+			}
+			value = argv[++i];
+		}
+
+		if(key == "config" ? !load_config(value, pb, opt) : !apply_checked(key, value, pb, opt))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Written to a temporary file first, so readers never see half a file
+static void write_atomically(const std::string& fname, const std::string& data)
+{
+	std::string tmp = fname + ".tmp";
+	{
+		std::ofstream f(tmp, std::ios::trunc);
+		f << data;
+		if(!f.good())
+		{
+			std::cerr << "Unable to write " << tmp << std::endl;
+			return;
+		}
+	}
+	std::rename(tmp.c_str(), fname.c_str());
+}
+
+static std::string format_utc(std::time_t t)
+{
+	char buf[64];
+	std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S UTC", std::gmtime(&t));
+	return buf;
+}
+
+// Appends completed sweeps from the waterfall, which holds them at up to
+// Waterfall::max_width columns, in the layout of rtl_power_fftw's -m output
+class Recorder
+{
+private:
+	std::string basename;
+	FILE* bin = nullptr;
+	uint64_t generation = 0;
+	uint64_t next_row = 0;
+	size_t width = 0;
+	uint64_t rows_written = 0;
+	std::time_t first_time = 0;
+	std::time_t last_time = 0;
+	std::vector<float> row;
+
+public:
+	bool open(const std::string& nbasename)
+	{
+		basename = nbasename;
+		bin = std::fopen((basename + ".bin").c_str(), "wb");
+		if(!bin)
+		{
+			std::cerr << "Unable to open " << basename << ".bin" << std::endl;
+		}
+		return bin != nullptr;
+	}
+
+	void poll(PlotBuilder& pb)
+	{
+		if(!bin)
+		{
+			return;
+		}
+
+		Waterfall::Info info = pb.waterfall.get_info();
+		if(info.generation != generation)
+		{
+			// Rows of a new layout would not match the metadata
+			if(rows_written > 0 && info.width != width)
+			{
+				return;
+			}
+			generation = info.generation;
+			next_row = info.head;
+			width = info.width;
+			row.resize(width);
+		}
+
+		// Rows overwritten before we got to them are lost
+		if(info.head > next_row + info.rows)
+		{
+			next_row = info.head - info.rows;
+		}
+		for(; next_row < info.head; next_row++)
+		{
+			if(pb.waterfall.read_row(generation, next_row, row.data()))
+			{
+				std::fwrite(row.data(), sizeof(float), width, bin);
+				last_time = std::time(nullptr);
+				if(rows_written++ == 0)
+				{
+					first_time = last_time;
+				}
+			}
+		}
+		std::fflush(bin);
+	}
+
+	// In the format Measurement::from_binFile_meta reads
+	void write_meta(Measurement& meas)
+	{
+		if(!bin || rows_written == 0)
+		{
+			return;
+		}
+
+		size_t bins = meas.spectrum.size();
+		double step = meas.get_hertz_per_bin() * bins / width;
+		double low = meas.get_low_freq();
+		double elapsed = std::difftime(last_time, first_time);
+		std::stringstream o;
+		o << width << " # frequency bins (columns)" << std::endl;
+		o << rows_written << " # scans (rows)" << std::endl;
+		o << (uint64_t)std::round(low) << " # startFreq (Hz)" << std::endl;
+		o << (uint64_t)std::round(low + (width - 1) * step) << " # endFreq (Hz)" << std::endl;
+		// Not rounded, bins are rarely a whole number of Hertz wide
+		o << std::setprecision(15) << step << std::setprecision(6) << " # stepFreq (Hz)" << std::endl;
+		o << (rows_written > 1 ? elapsed / (rows_written - 1) : 0.0) << " # avgScanDur (sec)" << std::endl;
+		o << format_utc(first_time) << " # firstAcqTimestamp UTC" << std::endl;
+		o << format_utc(last_time) << " # lastAcqTimestamp UTC" << std::endl;
+		write_atomically(basename + ".met", o.str());
+	}
+
+	~Recorder()
+	{
+		if(bin)
+		{
+			std::fclose(bin);
+		}
+	}
+};
+
+static void write_outputs(PlotBuilder& pb, const DaemonOptions& opt, Recorder& recorder)
+{
+	if(!opt.snapshot.empty())
+	{
+		write_atomically(opt.snapshot, pb.current.to_csv());
+		// Writing the snapshot is the daemon's equivalent of drawing it
+		pb.mark_drawn();
+	}
+	recorder.write_meta(pb.current);
+	if(!opt.latency.empty() && !pb.latency.dump(opt.latency))
+	{
+		std::cerr << "Unable to write " << opt.latency << std::endl;
+	}
+
+	std::cerr << "averaged " << pb.measurement_count << " hops " << pb.get_hops_received()
+			  << " dropped " << pb.get_hops_dropped() << " input " << pb.get_pipe_bytes_per_second() / 1e6
+			  << " MB/s" << (pb.get_power_status() ? " (not running)" : "") << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	PlotBuilder pb;
+	DaemonOptions opt;
+	if(argc < 2 || !parse_args(argc, argv, pb, opt))
+	{
+		usage();
+		return 1;
+	}
+
+	Recorder recorder;
+	if(!opt.record.empty() && !recorder.open(opt.record))
+	{
+		return 1;
+	}
+
+	std::signal(SIGINT, on_signal);
+	std::signal(SIGTERM, on_signal);
+
+	std::cerr << "DSP kernels: " << dsp::get_isa_name() << std::endl;
+	pb.update_averaging();
+	pb.launch();
+
+	auto start = std::chrono::steady_clock::now();
+	auto next_output = start + std::chrono::duration<double>(opt.interval);
+	while(!quit)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		pb.update();
+		recorder.poll(pb);
+
+		auto now = std::chrono::steady_clock::now();
+		if(now >= next_output)
+		{
+			write_outputs(pb, opt, recorder);
+			next_output = now + std::chrono::duration<double>(opt.interval);
+		}
+		if(opt.duration > 0.0 && now - start >= std::chrono::duration<double>(opt.duration))
+		{
+			break;
+		}
+	}
+
+	pb.stop();
+	pb.update();
+	recorder.poll(pb);
+	write_outputs(pb, opt, recorder);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Heap array aligned to cache lines (and so to any SIMD register size).
+// Contents are left uninitialized on resize.
+template<typename T, size_t alignment = 64>
+class AlignedBuffer
+{
+private:
+	T* ptr;
+	size_t num;
+
+public:
+
+	void resize(size_t n)
+	{
+		std::free(ptr);
+		ptr = nullptr;
+		num = n;
+		if(n != 0)
+		{
+			// aligned_alloc wants the size to be a multiple of the alignment
+			size_t bytes = (n * sizeof(T) + alignment - 1) / alignment * alignment;
+			ptr = (T*)std::aligned_alloc(alignment, bytes);
+			if(!ptr)
+			{
+				throw std::bad_alloc();
+			}
+		}
+	}
+
+	void fill_zero() { if(ptr) std::memset((void*)ptr, 0, num * sizeof(T)); }
+
+	T* data() { return ptr; }
+	const T* data() const { return ptr; }
+	size_t size() const { return num; }
+	T& operator[](size_t i) { return ptr[i]; }
+	const T& operator[](size_t i) const { return ptr[i]; }
+
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	AlignedBuffer() : ptr(nullptr), num(0) {}
+	~AlignedBuffer() { std::free(ptr); }
+};
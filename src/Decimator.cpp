@@ -0,0 +1,112 @@
+#include "Decimator.h"
+#include <algorithm>
+#include <cmath>
+
+bool Decimator::update(const double* y, size_t n, double nx0, double ndx,
+					   double nview_min, double nview_max, int ncolumns, uint64_t nversion,
+					   const SpectrumPyramid* pyramid)
+{
+	if(valid && nversion == version && n == num && nx0 == x0 && ndx == dx &&
+		nview_min == view_min && nview_max == view_max && ncolumns == columns)
+	{
+		return false;
+	}
+
+	valid = true;
+	version = nversion;
+	num = n;
+	x0 = nx0;
+	dx = ndx;
+	view_min = nview_min;
+	view_max = nview_max;
+	columns = std::max(ncolumns, 1);
+
+	// One extra bin on each side so lines reach the plot borders
+	first = 0;
+	last = n;
+	if(dx > 0.0)
+	{
+		double f = std::floor((view_min - x0) / dx) - 1.0;
+		double l = std::ceil((view_max - x0) / dx) + 2.0;
+		first = (size_t)std::clamp(f, 0.0, (double)n);
+		last = (size_t)std::clamp(l, (double)first, (double)n);
+	}
+
+	size_t count = last - first;
+	decimated = count > 2 * (size_t)columns;
+	xs.clear();
+	lo.clear();
+	hi.clear();
+	if(!decimated)
+	{
+		return true;
+	}
+
+	// Coarsest level with at least two entries per column
+	size_t level = 0;
+	bool use_pyramid = pyramid && pyramid->size() == n && pyramid->get_num_levels() > 0 &&
+		count >= 4 * (size_t)columns;
+	if(use_pyramid)
+	{
+		while(level + 1 < pyramid->get_num_levels() &&
+			  2 * pyramid->get_factor(level + 1) * columns <= count)
+		{
+			level++;
+		}
+	}
+
+	xs.resize(columns);
+	lo.resize(columns);
+	hi.resize(columns);
+	for(int c = 0; c < columns; c++)
+	{
+		size_t b0 = first + count * c / columns;
+		size_t b1 = first + count * (c + 1) / columns;
+		double vmin, vmax;
+		if(use_pyramid)
+		{
+			// Entries at the column borders may reach a few bins into the
+			// neighbours, less than half a column
+			size_t factor = pyramid->get_factor(level);
+			const float* plo = pyramid->get_lo(level);
+			const float* phi = pyramid->get_hi(level);
+			size_t e1 = (b1 - 1) / factor;
+			vmin = plo[b0 / factor];
+			vmax = phi[b0 / factor];
+			for(size_t e = b0 / factor + 1; e <= e1; e++)
+			{
+				vmin = std::min(vmin, (double)plo[e]);
+				vmax = std::max(vmax, (double)phi[e]);
+			}
+		}
+		else
+		{
+			vmin = y[b0];
+			vmax = y[b0];
+			for(size_t b = b0 + 1; b < b1; b++)
+			{
+				vmin = std::min(vmin, y[b]);
+				vmax = std::max(vmax, y[b]);
+			}
+		}
+		xs[c] = x0 + 0.5 * (b0 + b1 - 1) * dx;
+		lo[c] = vmin;
+		hi[c] = vmax;
+	}
+	return true;
+}
+
+Decimator::Decimator()
+{
+	version = 0;
+	num = 0;
+	x0 = 0.0;
+	dx = 0.0;
+	view_min = 0.0;
+	view_max = 0.0;
+	columns = 0;
+	valid = false;
+	first = 0;
+	last = 0;
+	decimated = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "SpectrumPyramid.h"
+
+// Reduces the visible part of an evenly spaced series to a min / max envelope
+// with one entry per pixel column, so plotting costs O(pixels) instead of O(bins)
+// while narrow peaks still show up. The result is cached and only recomputed
+// when the data version, the view or the plot width change. Given a pyramid of
+// y, each column only looks at a few entries of the coarsest fitting level.
+class Decimator
+{
+private:
+	uint64_t version;
+	size_t num;
+	double x0, dx;
+	double view_min, view_max;
+	int columns;
+	bool valid;
+
+	// Visible bins, if there's less than two per column the data is used as is
+	size_t first, last;
+	bool decimated;
+
+	std::vector<double> xs;
+	std::vector<double> lo;
+	std::vector<double> hi;
+
+public:
+
+	// y has n values, the first at x0 and then every dx. pyramid may be null or
+	// out of date (different size), then y is scanned. Returns true if recomputed.
+	bool update(const double* y, size_t n, double nx0, double ndx,
+				double nview_min, double nview_max, int ncolumns, uint64_t nversion,
+				const SpectrumPyramid* pyramid = nullptr);
+
+	bool is_decimated() const { return decimated; }
+	// Range of bins in view (when not decimated)
+	size_t get_first() const { return first; }
+	size_t get_count() const { return last - first; }
+
+	// Envelope (when decimated)
+	size_t get_columns() const { return xs.size(); }
+	double get_x(size_t col) const { return xs[col]; }
+	double get_lo(size_t col) const { return lo[col]; }
+	double get_hi(size_t col) const { return hi[col]; }
+
+	Decimator();
+};
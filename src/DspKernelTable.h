@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Shared by the translation units of the DSP kernels, not to be included elsewhere.
+// Each instruction set has its own file, so code built for one can't end up
+// called on a CPU that only supports another.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_X86
+#endif
+
+namespace dsp::detail
+{
+
+struct KernelTable
+{
+	const char* name;
+	void (*subtract)(double*, const double*, const double*, size_t);
+	void (*add)(double*, const double*, size_t);
+	void (*max)(double*, const double*, size_t);
+	void (*min)(double*, const double*, size_t);
+	void (*scale)(double*, double, size_t);
+	void (*widen)(double*, const float*, size_t);
+	void (*db_to_linear)(double*, const double*, size_t);
+	void (*linear_to_db)(double*, const double*, size_t);
+};
+
+// Constants of the fast exp / log approximations. 10^(x/10) is computed as
+// 2^n * e^(f ln2) with n integer and |f| <= 0.5, using a degree 7 Taylor polynomial.
+// log(m) for m in [sqrt(2)/2, sqrt(2)] uses the series of atanh((m-1)/(m+1)) up to s^9.
+constexpr double DB_TO_LOG2 = 0.33219280948873623; // log2(10) / 10
+constexpr double LN2 = 0.69314718055994531;
+constexpr double LN_TO_DB = 4.3429448190325182; // 10 / ln(10)
+constexpr double SQRT2 = 1.4142135623730951;
+constexpr double MIN_LINEAR = 1e-30;
+constexpr double MAX_LOG2 = 1000.0;
+constexpr uint64_t MANTISSA_MASK = 0x000FFFFFFFFFFFFFull;
+constexpr uint64_t ONE_BITS = 0x3FF0000000000000ull;
+
+// Plain C++ (DspKernels.cpp), also used for the tails the vector versions leave
+void subtract_scalar(double* dst, const double* a, const double* b, size_t n);
+void add_scalar(double* dst, const double* src, size_t n);
+void max_scalar(double* dst, const double* src, size_t n);
+void min_scalar(double* dst, const double* src, size_t n);
+void scale_scalar(double* dst, double k, size_t n);
+void widen_scalar(double* dst, const float* src, size_t n);
+void db_to_linear_scalar(double* dst, const double* src, size_t n);
+void linear_to_db_scalar(double* dst, const double* src, size_t n);
+
+extern const KernelTable scalar_table;
+#ifdef DSP_X86
+// DspKernelsSSE2.cpp, DspKernelsAVX2.cpp and DspKernelsAVX512.cpp
+extern const KernelTable sse2_table;
+extern const KernelTable avx2_table;
+extern const KernelTable avx512_table;
+#endif
+
+}
@@ -0,0 +1,166 @@
+#include "DspKernels.h"
+#include "DspKernelTable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <strings.h>
+
+namespace dsp::detail
+{
+
+void subtract_scalar(double* dst, const double* a, const double* b, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] = a[i] - b[i];
+}
+
+void add_scalar(double* dst, const double* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] += src[i];
+}
+
+void max_scalar(double* dst, const double* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] = std::max(dst[i], src[i]);
+}
+
+void min_scalar(double* dst, const double* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] = std::min(dst[i], src[i]);
+}
+
+void scale_scalar(double* dst, double k, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] *= k;
+}
+
+void widen_scalar(double* dst, const float* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+		dst[i] = src[i];
+}
+
+void db_to_linear_scalar(double* dst, const double* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+	{
+		double t = std::clamp(src[i] * DB_TO_LOG2, -MAX_LOG2, MAX_LOG2);
+		double k = std::nearbyint(t);
+		double f = (t - k) * LN2;
+		double p = 1.0 + f * (1.0 + f * (1.0 / 2 + f * (1.0 / 6 + f * (1.0 / 24 +
+			f * (1.0 / 120 + f * (1.0 / 720 + f * (1.0 / 5040)))))));
+		// Multiply by 2^k adding to the exponent
+		uint64_t bits;
+		std::memcpy(&bits, &p, sizeof(bits));
+		bits += (uint64_t)(int64_t)k << 52;
+		std::memcpy(&dst[i], &bits, sizeof(bits));
+	}
+}
+
+void linear_to_db_scalar(double* dst, const double* src, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+	{
+		double x = std::max(src[i], MIN_LINEAR);
+		uint64_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		double e = (double)(int64_t)(bits >> 52) - 1023.0;
+		bits = (bits & MANTISSA_MASK) | ONE_BITS;
+		double m;
+		std::memcpy(&m, &bits, sizeof(bits));
+		if(m > SQRT2)
+		{
+			m *= 0.5;
+			e += 1.0;
+		}
+		double s = (m - 1.0) / (m + 1.0);
+		double s2 = s * s;
+		double ln_m = 2.0 * s * (1.0 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 * (1.0 / 9)))));
+		dst[i] = LN_TO_DB * (ln_m + e * LN2);
+	}
+}
+
+const KernelTable scalar_table =
+{
+	"scalar",
+	subtract_scalar, add_scalar, max_scalar, min_scalar, scale_scalar, widen_scalar,
+	db_to_linear_scalar, linear_to_db_scalar
+};
+
+}
+
+namespace
+{
+
+using dsp::detail::KernelTable;
+
+struct Candidate
+{
+	const KernelTable* table;
+	bool supported;
+};
+
+const KernelTable& select_table()
+{
+	// Best first
+	Candidate candidates[4];
+	size_t num = 0;
+#ifdef DSP_X86
+	__builtin_cpu_init();
+	// These also check that the OS saves the wider registers
+	candidates[num++] = {&dsp::detail::avx512_table, (bool)__builtin_cpu_supports("avx512f")};
+	candidates[num++] = {&dsp::detail::avx2_table, (bool)__builtin_cpu_supports("avx2")};
+	candidates[num++] = {&dsp::detail::sse2_table, (bool)__builtin_cpu_supports("sse2")};
+#endif
+	candidates[num++] = {&dsp::detail::scalar_table, true};
+
+	// RTLPOWERGUI_DSP_ISA caps the choice, to compare them or to avoid
+	// the clock throttling of wide vectors on some CPUs
+	const char* cap = std::getenv("RTLPOWERGUI_DSP_ISA");
+	bool capped = cap && *cap;
+	for(size_t i = 0; i < num; i++)
+	{
+		if(capped && strcasecmp(cap, candidates[i].table->name) != 0)
+		{
+			continue;
+		}
+		capped = false;
+		if(candidates[i].supported)
+		{
+			return *candidates[i].table;
+		}
+	}
+
+	std::cerr << "Unknown RTLPOWERGUI_DSP_ISA " << cap << ", use AVX-512, AVX2, SSE2 or scalar" << std::endl;
+	return dsp::detail::scalar_table;
+}
+
+const KernelTable& table()
+{
+	static const KernelTable& t = select_table();
+	return t;
+}
+
+}
+
+namespace dsp
+{
+
+void subtract(double* dst, const double* a, const double* b, size_t n) { table().subtract(dst, a, b, n); }
+void add(double* dst, const double* src, size_t n) { table().add(dst, src, n); }
+void max(double* dst, const double* src, size_t n) { table().max(dst, src, n); }
+void min(double* dst, const double* src, size_t n) { table().min(dst, src, n); }
+void scale(double* dst, double k, size_t n) { table().scale(dst, k, n); }
+void widen(double* dst, const float* src, size_t n) { table().widen(dst, src, n); }
+void db_to_linear(double* dst, const double* src, size_t n) { table().db_to_linear(dst, src, n); }
+void linear_to_db(double* dst, const double* src, size_t n) { table().linear_to_db(dst, src, n); }
+
+const char* get_isa_name() { return table().name; }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+
+// Vectorized kernels for whole hops / sweeps of bins. The best implementation
+// for the running CPU (AVX-512, AVX2, SSE2 or plain C++) is chosen the first time
+// they are used, the RTLPOWERGUI_DSP_ISA environment variable can set a lower one.
+namespace dsp
+{
+	// dst[i] = a[i] - b[i], dst may be a
+	void subtract(double* dst, const double* a, const double* b, size_t n);
+	// dst[i] += src[i]
+	void add(double* dst, const double* src, size_t n);
+	// dst[i] = max(dst[i], src[i])
+	void max(double* dst, const double* src, size_t n);
+	// dst[i] = min(dst[i], src[i])
+	void min(double* dst, const double* src, size_t n);
+	// dst[i] *= k
+	void scale(double* dst, double k, size_t n);
+	// dst[i] = src[i]
+	void widen(double* dst, const float* src, size_t n);
+
+	// dst[i] = 10^(src[i] / 10), dB to linear power. Relative error below 1e-8,
+	// inputs are clamped to +-3000 dB. dst may be src.
+	void db_to_linear(double* dst, const double* src, size_t n);
+	// dst[i] = 10 * log10(src[i]), linear power to dB. Absolute error below 1e-7 dB,
+	// inputs are clamped to at least 1e-30 (-300 dB). dst may be src.
+	void linear_to_db(double* dst, const double* src, size_t n);
+
+	// Name of the instruction set in use
+	const char* get_isa_name();
+}
@@ -0,0 +1,126 @@
+#include "DspKernelTable.h"
+
+#ifdef DSP_X86
+#include <immintrin.h>
+
+namespace dsp::detail
+{
+
+namespace
+{
+
+// Binary operation on 4 doubles at a time
+#define DSP_AVX2_BINARY(name, op) \
+__attribute__((target("avx2"))) void name##_avx2(double* dst, const double* src, size_t n) \
+{ \
+	size_t i = 0; \
+	for(; i + 4 <= n; i += 4) \
+		_mm256_storeu_pd(dst + i, op(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i))); \
+	name##_scalar(dst + i, src + i, n - i); \
+}
+
+DSP_AVX2_BINARY(add, _mm256_add_pd)
+DSP_AVX2_BINARY(max, _mm256_max_pd)
+DSP_AVX2_BINARY(min, _mm256_min_pd)
+
+__attribute__((target("avx2"))) void subtract_avx2(double* dst, const double* a, const double* b, size_t n)
+{
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(dst + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	subtract_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) void scale_avx2(double* dst, double k, size_t n)
+{
+	__m256d vk = _mm256_set1_pd(k);
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(dst + i), vk));
+	scale_scalar(dst + i, k, n - i);
+}
+
+__attribute__((target("avx2"))) void widen_avx2(double* dst, const float* src, size_t n)
+{
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+	widen_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) void db_to_linear_avx2(double* dst, const double* src, size_t n)
+{
+	const __m256d to_log2 = _mm256_set1_pd(DB_TO_LOG2);
+	const __m256d lo = _mm256_set1_pd(-MAX_LOG2);
+	const __m256d hi = _mm256_set1_pd(MAX_LOG2);
+	const __m256d ln2 = _mm256_set1_pd(LN2);
+	// Adding this leaves a small integer in the low mantissa bits
+	const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		__m256d t = _mm256_mul_pd(_mm256_loadu_pd(src + i), to_log2);
+		t = _mm256_min_pd(_mm256_max_pd(t, lo), hi);
+		__m256d k = _mm256_round_pd(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d f = _mm256_mul_pd(_mm256_sub_pd(t, k), ln2);
+		__m256d p = _mm256_set1_pd(1.0 / 5040);
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 720));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 120));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 24));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 6));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 2));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0));
+		p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0));
+		__m256i kbits = _mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(k, magic)), 52);
+		p = _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(p), kbits));
+		_mm256_storeu_pd(dst + i, p);
+	}
+	db_to_linear_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) void linear_to_db_avx2(double* dst, const double* src, size_t n)
+{
+	const __m256d min_linear = _mm256_set1_pd(MIN_LINEAR);
+	const __m256i mantissa_mask = _mm256_set1_epi64x(MANTISSA_MASK);
+	const __m256i one_bits = _mm256_set1_epi64x(ONE_BITS);
+	// Or'ed into a small integer, gives 2^52 + that integer as a double
+	const __m256i two52_bits = _mm256_set1_epi64x(0x4330000000000000ll);
+	const __m256d two52_bias = _mm256_set1_pd(4503599627370496.0 + 1023.0);
+	const __m256d sqrt2 = _mm256_set1_pd(SQRT2);
+	const __m256d one = _mm256_set1_pd(1.0);
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		__m256d x = _mm256_max_pd(_mm256_loadu_pd(src + i), min_linear);
+		__m256i bits = _mm256_castpd_si256(x);
+		__m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), two52_bits)), two52_bias);
+		__m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), one_bits));
+		__m256d big = _mm256_cmp_pd(m, sqrt2, _CMP_GT_OQ);
+		m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+		e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+		__m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+		__m256d s2 = _mm256_mul_pd(s, s);
+		__m256d p = _mm256_set1_pd(1.0 / 9);
+		p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0 / 7));
+		p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0 / 5));
+		p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0 / 3));
+		p = _mm256_add_pd(_mm256_mul_pd(p, s2), one);
+		__m256d ln_m = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), s), p);
+		__m256d ln_x = _mm256_add_pd(ln_m, _mm256_mul_pd(e, _mm256_set1_pd(LN2)));
+		_mm256_storeu_pd(dst + i, _mm256_mul_pd(ln_x, _mm256_set1_pd(LN_TO_DB)));
+	}
+	linear_to_db_scalar(dst + i, src + i, n - i);
+}
+
+}
+
+const KernelTable avx2_table =
+{
+	"AVX2",
+	subtract_avx2, add_avx2, max_avx2, min_avx2, scale_avx2, widen_avx2,
+	db_to_linear_avx2, linear_to_db_avx2
+};
+
+}
+
+#endif
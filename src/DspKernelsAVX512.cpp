@@ -0,0 +1,141 @@
+#include "DspKernelTable.h"
+
+#ifdef DSP_X86
+#include <immintrin.h>
+
+// GCC 12's AVX-512 intrinsics start from deliberately uninitialized vectors (bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace dsp::detail
+{
+
+namespace
+{
+
+// Lanes [0, count) of a vector of 8 doubles, the tails are done with masked loads
+// and stores instead of falling back to scalar code
+__attribute__((target("avx512f"))) inline __mmask8 lanes(size_t count)
+{
+	return count >= 8 ? 0xFF : (__mmask8)((1u << count) - 1);
+}
+
+// Binary operation on 8 doubles at a time
+#define DSP_AVX512_BINARY(name, op) \
+__attribute__((target("avx512f"))) void name##_avx512(double* dst, const double* src, size_t n) \
+{ \
+	for(size_t i = 0; i < n; i += 8) \
+	{ \
+		__mmask8 m = lanes(n - i); \
+		_mm512_mask_storeu_pd(dst + i, m, op(_mm512_maskz_loadu_pd(m, dst + i), _mm512_maskz_loadu_pd(m, src + i))); \
+	} \
+}
+
+DSP_AVX512_BINARY(add, _mm512_add_pd)
+DSP_AVX512_BINARY(max, _mm512_max_pd)
+DSP_AVX512_BINARY(min, _mm512_min_pd)
+
+__attribute__((target("avx512f"))) void subtract_avx512(double* dst, const double* a, const double* b, size_t n)
+{
+	for(size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = lanes(n - i);
+		_mm512_mask_storeu_pd(dst + i, m, _mm512_sub_pd(_mm512_maskz_loadu_pd(m, a + i), _mm512_maskz_loadu_pd(m, b + i)));
+	}
+}
+
+__attribute__((target("avx512f"))) void scale_avx512(double* dst, double k, size_t n)
+{
+	__m512d vk = _mm512_set1_pd(k);
+	for(size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = lanes(n - i);
+		_mm512_mask_storeu_pd(dst + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, dst + i), vk));
+	}
+}
+
+// Masked 256 bit loads need AVX-512VL, so this leaves a scalar tail
+__attribute__((target("avx512f"))) void widen_avx512(double* dst, const float* src, size_t n)
+{
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(dst + i, _mm512_cvtps_pd(_mm256_loadu_ps(src + i)));
+	widen_scalar(dst + i, src + i, n - i);
+}
+
+// Same approximations as the AVX2 versions, with fused multiply-adds
+__attribute__((target("avx512f"))) void db_to_linear_avx512(double* dst, const double* src, size_t n)
+{
+	const __m512d to_log2 = _mm512_set1_pd(DB_TO_LOG2);
+	const __m512d lo = _mm512_set1_pd(-MAX_LOG2);
+	const __m512d hi = _mm512_set1_pd(MAX_LOG2);
+	const __m512d ln2 = _mm512_set1_pd(LN2);
+	// Adding this leaves a small integer in the low mantissa bits
+	const __m512d magic = _mm512_set1_pd(6755399441055744.0);
+	for(size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = lanes(n - i);
+		__m512d t = _mm512_mul_pd(_mm512_maskz_loadu_pd(m, src + i), to_log2);
+		t = _mm512_min_pd(_mm512_max_pd(t, lo), hi);
+		__m512d k = _mm512_roundscale_pd(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m512d f = _mm512_mul_pd(_mm512_sub_pd(t, k), ln2);
+		__m512d p = _mm512_set1_pd(1.0 / 5040);
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 720));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 120));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 24));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 6));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 2));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+		p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+		__m512i kbits = _mm512_slli_epi64(_mm512_castpd_si512(_mm512_add_pd(k, magic)), 52);
+		p = _mm512_castsi512_pd(_mm512_add_epi64(_mm512_castpd_si512(p), kbits));
+		_mm512_mask_storeu_pd(dst + i, m, p);
+	}
+}
+
+__attribute__((target("avx512f"))) void linear_to_db_avx512(double* dst, const double* src, size_t n)
+{
+	const __m512d min_linear = _mm512_set1_pd(MIN_LINEAR);
+	const __m512i mantissa_mask = _mm512_set1_epi64(MANTISSA_MASK);
+	const __m512i one_bits = _mm512_set1_epi64(ONE_BITS);
+	// Or'ed into a small integer, gives 2^52 + that integer as a double
+	const __m512i two52_bits = _mm512_set1_epi64(0x4330000000000000ll);
+	const __m512d two52_bias = _mm512_set1_pd(4503599627370496.0 + 1023.0);
+	const __m512d sqrt2 = _mm512_set1_pd(SQRT2);
+	const __m512d one = _mm512_set1_pd(1.0);
+	for(size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = lanes(n - i);
+		__m512d x = _mm512_max_pd(_mm512_maskz_loadu_pd(m, src + i), min_linear);
+		__m512i bits = _mm512_castpd_si512(x);
+		__m512d e = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(bits, 52), two52_bits)), two52_bias);
+		__m512d mant = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, mantissa_mask), one_bits));
+		__mmask8 big = _mm512_cmp_pd_mask(mant, sqrt2, _CMP_GT_OQ);
+		mant = _mm512_mask_mul_pd(mant, big, mant, _mm512_set1_pd(0.5));
+		e = _mm512_mask_add_pd(e, big, e, one);
+		__m512d s = _mm512_div_pd(_mm512_sub_pd(mant, one), _mm512_add_pd(mant, one));
+		__m512d s2 = _mm512_mul_pd(s, s);
+		__m512d p = _mm512_set1_pd(1.0 / 9);
+		p = _mm512_fmadd_pd(p, s2, _mm512_set1_pd(1.0 / 7));
+		p = _mm512_fmadd_pd(p, s2, _mm512_set1_pd(1.0 / 5));
+		p = _mm512_fmadd_pd(p, s2, _mm512_set1_pd(1.0 / 3));
+		p = _mm512_fmadd_pd(p, s2, one);
+		__m512d ln_m = _mm512_mul_pd(_mm512_add_pd(s, s), p);
+		__m512d ln_x = _mm512_fmadd_pd(e, _mm512_set1_pd(LN2), ln_m);
+		_mm512_mask_storeu_pd(dst + i, m, _mm512_mul_pd(ln_x, _mm512_set1_pd(LN_TO_DB)));
+	}
+}
+
+}
+
+const KernelTable avx512_table =
+{
+	"AVX-512",
+	subtract_avx512, add_avx512, max_avx512, min_avx512, scale_avx512, widen_avx512,
+	db_to_linear_avx512, linear_to_db_avx512
+};
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "DspKernelTable.h"
+
+#ifdef DSP_X86
+#include <immintrin.h>
+
+namespace dsp::detail
+{
+
+namespace
+{
+
+// Binary operation on 2 doubles at a time
+#define DSP_SSE2_BINARY(name, op) \
+__attribute__((target("sse2"))) void name##_sse2(double* dst, const double* src, size_t n) \
+{ \
+	size_t i = 0; \
+	for(; i + 2 <= n; i += 2) \
+		_mm_storeu_pd(dst + i, op(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i))); \
+	name##_scalar(dst + i, src + i, n - i); \
+}
+
+DSP_SSE2_BINARY(add, _mm_add_pd)
+DSP_SSE2_BINARY(max, _mm_max_pd)
+DSP_SSE2_BINARY(min, _mm_min_pd)
+
+__attribute__((target("sse2"))) void subtract_sse2(double* dst, const double* a, const double* b, size_t n)
+{
+	size_t i = 0;
+	for(; i + 2 <= n; i += 2)
+		_mm_storeu_pd(dst + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+	subtract_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) void scale_sse2(double* dst, double k, size_t n)
+{
+	__m128d vk = _mm_set1_pd(k);
+	size_t i = 0;
+	for(; i + 2 <= n; i += 2)
+		_mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(dst + i), vk));
+	scale_scalar(dst + i, k, n - i);
+}
+
+__attribute__((target("sse2"))) void widen_sse2(double* dst, const float* src, size_t n)
+{
+	size_t i = 0;
+	for(; i + 2 <= n; i += 2)
+		_mm_storeu_pd(dst + i, _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(src + i)))));
+	widen_scalar(dst + i, src + i, n - i);
+}
+
+}
+
+const KernelTable sse2_table =
+{
+	"SSE2",
+	subtract_sse2, add_sse2, max_sse2, min_sse2, scale_sse2, widen_sse2,
+	// The SSE2 versions of these would need SSE4.1 for rounding, so they stay scalar
+	db_to_linear_scalar, linear_to_db_scalar
+};
+
+}
+
+#endif
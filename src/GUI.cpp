@@ -4,6 +4,8 @@
 #include <fstream>
 #include <iostream>
 #include "portable-file-dialogs.h"
+#include "DspKernels.h"
+#include "hello_imgui/hello_imgui_include_opengl.h"
 
 void GUI::gui_function()
 {	
@@ -24,7 +26,7 @@ void GUI::gui_function()
 
 		if (ImGui::CollapsingHeader("Connection", ImGuiTreeNodeFlags_DefaultOpen)) //
 		{
-			ImGui::Text("rtl_power_fftw %s", pb.get_power_status() ? "Not connected" : "Connected");	
+			do_connection_menu();
 		}
 
 		if (ImGui::CollapsingHeader("Ranges", ImGuiTreeNodeFlags_DefaultOpen))
@@ -47,14 +49,79 @@ void GUI::gui_function()
 			do_export_menu();
 		}
 
+		if (ImGui::CollapsingHeader("Latency", ImGuiTreeNodeFlags_OpenOnArrow))
+		{
+			do_latency_menu();
+		}
+
 		ImGui::NextColumn();
 		do_plot();
+		if(show_waterfall)
+		{
+			do_plot_watterflow();
+		}
 	}
 }
 
 void GUI::do_connection_menu()
 {
-
+	static const char* source_kinds[] = {"rtl_power_fftw", "In-process", "Replay", "Synthetic"};
+	ImGui::Text("%s %s, %zu device(s)", source_kinds[(int)pb.source_kind],
+				pb.get_power_status() ? "Not connected" : "Connected", pb.get_num_devices());
+	ImGui::Text("Input: %.2f MB/s, %.0f lines/s", pb.get_pipe_bytes_per_second() / 1e6,
+				pb.get_pipe_lines_per_second());
+	ImGui::Text("Hops: %llu, dropped %llu", (unsigned long long)pb.get_hops_received(),
+				(unsigned long long)pb.get_hops_dropped());
+	ImGui::Text("Queue: %zu / %zu per device (peak %zu)", pb.get_hops_queued(), pb.get_hops_capacity(),
+				pb.get_hops_high_water());
+	ImGui::Text("Hop allocations: %llu", (unsigned long long)pb.get_allocations());
+
+	ImGui::BeginDisabled(!pb.can_change_settings());
+	int kind = (int)pb.source_kind;
+	neat_element("Source");
+	if(ImGui::Combo("##source", &kind, source_kinds, IM_ARRAYSIZE(source_kinds)))
+	{
+		pb.source_kind = (SourceKind)kind;
+	}
+	if(pb.source_kind == SourceKind::direct)
+	{
+		neat_element("IQ file");
+		ImGui::InputTextWithHint("##iqfile", "none, use devices (on commit)", pb.iq_file, sizeof(pb.iq_file));
+	}
+	else if(pb.source_kind == SourceKind::replay)
+	{
+		neat_element("Recording");
+		ImGui::InputTextWithHint("##replayfile", "text, .bin or .met (on commit)", pb.replay_file, sizeof(pb.replay_file));
+	}
+	else if(pb.source_kind == SourceKind::synthetic)
+	{
+		neat_element("Tones");
+		ImGui::InputTextWithHint("##tones", "MHz, comma separated (on commit)", pb.tones, sizeof(pb.tones));
+	}
+	else
+	{
+		neat_element("Command");
+		ImGui::InputTextWithHint("##command", "rtl_power_fftw (on commit)", pb.power_command, sizeof(pb.power_command));
+		ImGui::Checkbox("Binary transfer (on commit)", &pb.binary_transfer);
+	}
+	if(pb.source_kind == SourceKind::replay || pb.source_kind == SourceKind::synthetic)
+	{
+		neat_element("Hops/s");
+		ImGui::InputFloat("##hoprate", &pb.hop_rate);
+	}
+	neat_element("Devices");
+	ImGui::InputTextWithHint("##devices", "0,1,... (on commit)", pb.devices, sizeof(pb.devices));
+	ImGui::Checkbox("Revisit busy segments (on commit)", &pb.adaptive_sweep);
+	if(pb.adaptive_sweep)
+	{
+		neat_element("Revisits");
+		ImGui::InputInt("##revisits", &pb.adaptive_revisits);
+	}
+	ImGui::EndDisabled();
+	if(pb.adaptive_sweep)
+	{
+		ImGui::Text("Busy segments: %zu", pb.busy_segments.load());
+	}
 }
 
 void GUI::do_ranges_menu()
@@ -145,20 +212,61 @@ void GUI::do_display_menu()
 		update_view_now = true;
 	}
 
-	neat_element("History Len");
-	if(ImGui::InputInt("##numhistory", &pb.num_average_hold))
+	neat_element("Averaging");
+	if(ImGui::Combo("##avgmode", &pb.averaging.mode, averaging_mode, IM_ARRAYSIZE(averaging_mode)))
 	{
 		pb.update_averaging();
 	}
-	ImGui::Text("Saved: %i", pb.measurement_count);
+	if(pb.averaging.mode == 0)
+	{
+		neat_element("History Len");
+		if(ImGui::InputInt("##numhistory", &pb.averaging.history))
+		{
+			pb.update_averaging();
+		}
+		ImGui::Text("Saved: %i", pb.measurement_count.load());
+	}
+	else
+	{
+		neat_element("Time const.");
+		if(ImGui::InputFloat("##timeconst", &pb.averaging.time_constant))
+		{
+			pb.update_averaging();
+		}
+		neat_element("Peak decay");
+		if(ImGui::InputFloat("##peakdecay", &pb.averaging.peak_decay, 0.0f, 0.0f, "%.3f dB"))
+		{
+			pb.update_averaging();
+		}
+	}
+	if(ImGui::Checkbox("Average linear power (mW)", &pb.averaging.linear))
+	{
+		pb.update_averaging();
+	}
+	ImGui::Text("History memory: %.1f MB", pb.history_memory / 1e6);
+	ImGui::Text("DSP kernels: %s", dsp::get_isa_name());
+
+	ImGui::Checkbox("Waterfall", &show_waterfall);
+	if(show_waterfall)
+	{
+		neat_element("Color range");
+		ImGui::PushItemWidth(95.0f);
+		ImGui::InputFloat("##wfmin", &waterfall_min, 0.0f, 0.0f, "%.0f dB");
+		ImGui::SameLine();
+		ImGui::InputFloat("##wfmax", &waterfall_max, 0.0f, 0.0f, "%.0f dB");
+		ImGui::PopItemWidth();
+	}
 	ImGui::PopItemWidth();
 }
 
 void GUI::do_plot()
 {
-	ImPlot::BeginPlot("Test", ImVec2(-1, -1), ImPlotFlags_NoTitle | ImPlotFlags_NoFrame);
+	// With the waterfall below, the spectrum takes the upper half
+	ImVec2 size(-1, show_waterfall ? ImGui::GetContentRegionAvail().y * 0.5f : -1);
+	ImPlot::BeginPlot("Test", size, ImPlotFlags_NoTitle | ImPlotFlags_NoFrame);
 	ImPlot::SetupAxisFormat(ImAxis_X1, MetricFormatter, (void*)"Hz");
 	ImPlot::SetupAxisFormat(ImAxis_Y1, "%g dB");
+	ImPlot::SetupAxisLinks(ImAxis_X1, &view_min_freq, &view_max_freq);
 	if(update_view && update_view_now)
 	{
 		if(pb.has_baseline())
@@ -173,37 +281,161 @@ void GUI::do_plot()
 		}
 		update_view_now = false;
 	}
-	ImPlot::PlotLine("Spectrum", pb.current.spectrum.data(), pb.current.spectrum.size(),
-					 pb.current.get_bin_scale(), pb.current.get_low_freq());
-	ImPlot::HideNextItem();
-	ImPlot::PlotLine("Averages", pb.current.average.data(), pb.current.spectrum.size(),
-					 pb.current.get_bin_scale(), pb.current.get_low_freq());
-	ImPlot::HideNextItem();
-	ImPlot::PlotLine("Maximums", pb.current.max.data(), pb.current.spectrum.size(),
-					 pb.current.get_bin_scale(), pb.current.get_low_freq());
-	ImPlot::HideNextItem();
-	ImPlot::PlotLine("Minimums", pb.current.min.data(), pb.current.spectrum.size(),
-					 pb.current.get_bin_scale(), pb.current.get_low_freq());
+	plot_series("Spectrum", plot_lod[0], pb.current.spectrum, pb.current.spectrum_pyramid, false);
+	plot_series("Averages", plot_lod[1], pb.current.average, pb.current.average_pyramid, true);
+	plot_series("Maximums", plot_lod[2], pb.current.max, pb.current.max_pyramid, true);
+	plot_series("Minimums", plot_lod[3], pb.current.min, pb.current.min_pyramid, true);
 	ImPlot::EndPlot();
+	pb.mark_drawn();
+}
+
+static ImPlotPoint lod_getter_lo(int idx, void* data)
+{
+	const Decimator* lod = (const Decimator*)data;
+	return ImPlotPoint(lod->get_x(idx), lod->get_lo(idx));
+}
+
+static ImPlotPoint lod_getter_hi(int idx, void* data)
+{
+	const Decimator* lod = (const Decimator*)data;
+	return ImPlotPoint(lod->get_x(idx), lod->get_hi(idx));
+}
+
+// Goes down and up every column, so the line covers the whole envelope
+static ImPlotPoint lod_getter_zigzag(int idx, void* data)
+{
+	const Decimator* lod = (const Decimator*)data;
+	size_t col = idx / 2;
+	return ImPlotPoint(lod->get_x(col), idx % 2 ? lod->get_hi(col) : lod->get_lo(col));
+}
+
+void GUI::plot_series(const char* label, Decimator& lod, const std::vector<double>& y,
+					  const SpectrumPyramid& pyramid, bool hidden)
+{
+	// Plotting every bin of a wide sweep means millions of vertices for a few
+	// thousand pixels, so we plot the min / max of every pixel column instead
+	ImPlotRect limits = ImPlot::GetPlotLimits();
+	int columns = (int)ImPlot::GetPlotSize().x;
+	size_t n = std::min(y.size(), pb.current.spectrum.size());
+	double dx = pb.current.get_bin_scale();
+	double x0 = pb.current.get_low_freq();
+	lod.update(y.data(), n, x0, dx, limits.X.Min, limits.X.Max, columns, pb.current_version, &pyramid);
+
+	if(hidden)
+		ImPlot::HideNextItem();
+
+	if(!lod.is_decimated())
+	{
+		ImPlot::PlotLine(label, y.data() + lod.get_first(), lod.get_count(), dx, x0 + lod.get_first() * dx);
+	}
+	else
+	{
+		ImPlot::SetNextFillStyle(IMPLOT_AUTO_COL, 0.3f);
+		ImPlot::PlotShadedG(label, lod_getter_lo, &lod, lod_getter_hi, &lod, lod.get_columns());
+		ImPlot::PlotLineG(label, lod_getter_zigzag, &lod, 2 * lod.get_columns());
+	}
+}
+
+void GUI::update_waterfall_texture()
+{
+	Waterfall::Info info = pb.waterfall.get_info();
+
+	if(waterfall_texture == 0 || info.generation != waterfall_generation)
+	{
+		if(waterfall_texture == 0)
+		{
+			glGenTextures(1, &waterfall_texture);
+			glBindTexture(GL_TEXTURE_2D, waterfall_texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			for(int i = 0; i < 256; i++)
+			{
+				waterfall_lut[i] = ImGui::ColorConvertFloat4ToU32(
+						ImPlot::SampleColormap(i / 255.0f, ImPlotColormap_Viridis));
+			}
+		}
+
+		waterfall_generation = info.generation;
+		waterfall_rows = info.rows;
+		waterfall_width = info.width;
+		waterfall_uploaded = 0;
+		waterfall_row.resize(waterfall_width);
+		waterfall_rgba.assign(waterfall_width * waterfall_rows, waterfall_lut[0]);
+
+		glBindTexture(GL_TEXTURE_2D, waterfall_texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, waterfall_width, waterfall_rows, 0,
+					 GL_RGBA, GL_UNSIGNED_BYTE, waterfall_rgba.data());
+		waterfall_rgba.resize(waterfall_width);
+	}
+
+	if(waterfall_rows == 0 || waterfall_width == 0)
+	{
+		return;
+	}
+
+	// Rows older than the ring are gone anyway
+	if(info.head > waterfall_rows && waterfall_uploaded < info.head - waterfall_rows)
+	{
+		waterfall_uploaded = info.head - waterfall_rows;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, waterfall_texture);
+	float scale = 255.0f / std::max(waterfall_max - waterfall_min, 1e-3f);
+	for(; waterfall_uploaded < info.head; waterfall_uploaded++)
+	{
+		if(!pb.waterfall.read_row(waterfall_generation, waterfall_uploaded, waterfall_row.data()))
+		{
+			continue;
+		}
+		for(size_t i = 0; i < waterfall_width; i++)
+		{
+			float t = (waterfall_row[i] - waterfall_min) * scale;
+			int idx = t <= 0.0f ? 0 : (t >= 255.0f ? 255 : (int)t);
+			waterfall_rgba[i] = waterfall_lut[idx];
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, waterfall_uploaded % waterfall_rows, waterfall_width, 1,
+						GL_RGBA, GL_UNSIGNED_BYTE, waterfall_rgba.data());
+	}
 }
 
 void GUI::do_plot_watterflow()
 {
-	
-	ImPlot::SetupAxisFormat(ImAxis_X1, MetricFormatter, (void*)"Hz");
-	ImPlot::SetupAxisFormat(ImAxis_Y1, "%g dB");
+	update_waterfall_texture();
 
-	ImPlot::BeginPlot("##Plot1",ImVec2(-1, -2),ImPlotFlags_NoMouseText);
-	ImPlot::SetupAxes(NULL,NULL,ImPlotAxisFlags_NoTickLabels,ImPlotAxisFlags_Lock);
-	ImPlot::SetupAxesLimits(pb.current.get_low_freq(), pb.current.get_high_freq(),
-							-80.0, 0.0, ImPlotCond_Always);
+	if(ImPlot::BeginPlot("##Waterfall", ImVec2(-80, -1), ImPlotFlags_NoTitle | ImPlotFlags_NoFrame |
+							ImPlotFlags_NoMouseText | ImPlotFlags_NoLegend))
+	{
+		ImPlot::SetupAxes(nullptr, "Sweeps", ImPlotAxisFlags_None, ImPlotAxisFlags_Lock);
+		ImPlot::SetupAxisFormat(ImAxis_X1, MetricFormatter, (void*)"Hz");
+		ImPlot::SetupAxisLinks(ImAxis_X1, &view_min_freq, &view_max_freq);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, 0, waterfall_rows, ImPlotCond_Always);
 
-	ImPlot::SetupAxisLimits(ImAxis_Y1,0,20);
-	ImPlot::SetupAxisFormat(ImAxis_Y1,"%g kHz");
-	//ImPlot::PlotHeatmap("##Heat", pb.current.spectrum.data(),pb.current.spectrum.size(), 200, pb.exposed.nbins, 0.0, pb.current.get_bin_scale(), NULL);
+		if(waterfall_rows != 0)
+		{
+			// The ring is drawn in two parts so the newest row is always on top.
+			// ImPlot puts uv0 at the top of the image, so both are flipped:
+			// texture rows [0, split) go on top with split - 1 (the newest) highest,
+			// and [split, rows) below with split (the oldest) at y = 0.
+			// With rows = 4 and 7 uploaded, top to bottom is 6, 5, 4, 3.
+			ImTextureID tex = (ImTextureID)(intptr_t)waterfall_texture;
+			double low = pb.current.get_low_freq();
+			double high = pb.current.get_high_freq();
+			double rows = waterfall_rows;
+			double split = waterfall_uploaded % waterfall_rows;
+			ImPlot::PlotImage("##Older", tex, ImPlotPoint(low, 0), ImPlotPoint(high, rows - split),
+							  ImVec2(0, 1), ImVec2(1, split / rows));
+			ImPlot::PlotImage("##Newer", tex, ImPlotPoint(low, rows - split), ImPlotPoint(high, rows),
+							  ImVec2(0, split / rows), ImVec2(1, 0));
+		}
+		ImPlot::EndPlot();
+	}
 	ImGui::SameLine();
-    ImPlot::ColormapScale("##Scale", -80.0, 0.0,{100, 320.0f},"%g dB");
-	ImPlot::EndPlot();
+	ImPlot::ColormapScale("##Scale", waterfall_min, waterfall_max, ImVec2(70, -1), "%g dB", 0,
+						  ImPlotColormap_Viridis);
 }
 
 
@@ -251,13 +483,37 @@ void GUI::do_export_menu()
 	ImGui::BeginDisabled(!pb.baseline.has_value());
 	if(ImGui::Button("Clear baseline"))
 	{
-		pb.baseline.reset();
+		pb.set_baseline(std::nullopt);
 		update_view_now = true;
 		save_and_load_baseline = true;
 	}
 	ImGui::EndDisabled();
 }
 
+void GUI::do_latency_menu()
+{
+	for(size_t s = 0; s < PipelineLatency::num_stages; s++)
+	{
+		const LatencyHistogram& h = pb.latency.stages[s];
+		ImGui::Text("%-9s p50 %8.2f  p99 %8.2f  max %8.2f ms", PipelineLatency::stage_names[s],
+					h.get_percentile(0.5) / 1e3, h.get_percentile(0.99) / 1e3, h.get_max() / 1e3);
+	}
+
+	if(ImGui::Button("Reset"))
+	{
+		pb.latency.reset();
+	}
+	ImGui::SameLine();
+	if(ImGui::Button("Dump..."))
+	{
+		auto file = pfd::save_file("Dump latency histograms", "latency.txt", {"Text files", "*.txt"}).result();
+		if(!file.empty() && !pb.latency.dump(file))
+		{
+			std::cerr << "Unable to write " << file << std::endl;
+		}
+	}
+}
+
 void GUI::do_import_menu()
 {
 
@@ -275,6 +531,8 @@ void GUI::do_import_menu()
 		Measurement::from_binFile_meta( filename + ".met", pb.current );
 
 		Measurement::from_binFile_raw( filename + ".bin", pb.current );
+		pb.current.rebuild_pyramids();
+		pb.current_version++;
 		
 		perform_load(pb.current);
 
@@ -282,6 +540,15 @@ void GUI::do_import_menu()
 	}
 }
 
+void GUI::release_textures()
+{
+	if(waterfall_texture != 0)
+	{
+		glDeleteTextures(1, &waterfall_texture);
+		waterfall_texture = 0;
+	}
+}
+
 GUI::GUI()
 {
 	pb.launch();
@@ -303,9 +570,11 @@ void GUI::perform_load(Measurement& meas)
 				meas.min[i] += pb.baseline.value().get_baseline_bin(pb.baseline_mode)[i];
 				meas.max[i] += pb.baseline.value().get_baseline_bin(pb.baseline_mode)[i];
 			}
+			meas.rebuild_pyramids();
+			pb.current_version++;
 		}
 		pb.exposed = meas.settings;
-		pb.baseline = meas;
+		pb.set_baseline(meas);
 		pb.commit_settings();
 		if(update_view)
 			update_view_now = true;
@@ -316,7 +585,7 @@ void GUI::perform_load(Measurement& meas)
 	if(load_measurement_from_bin)
 	{
 		pb.exposed = meas.settings;
-		pb.baseline = meas;
+		pb.set_baseline(meas);
 		if(update_view)
 			update_view_now = true;
 		
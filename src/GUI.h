@@ -2,6 +2,7 @@
 #include "hello_imgui/hello_imgui.h"
 #include "implot.h"
 #include "PlotBuilder.h"
+#include "Decimator.h"
 
 int MetricFormatter(double value, char* buff, int size, void* data);
 
@@ -12,6 +13,7 @@ private:
 
 	constexpr static const char* units[] = {"Hz", "kHz", "MHz", "GHz"};
 	constexpr static const char* baseline_mode[] = {"Spectrum", "Average", "Max", "Min"};
+	constexpr static const char* averaging_mode[] = {"History", "Exponential"};
 	bool save_and_load_baseline;
 	bool load_measurement_from_bin;
 
@@ -20,9 +22,34 @@ private:
 	bool first_run = true;
 	bool update_view = true;
 	bool update_view_now = true;
+	bool show_waterfall = false;
+
+	// Shared by the spectrum and waterfall plots so they zoom together
+	double view_min_freq = 0.0;
+	double view_max_freq = 1.0;
+
+	// Waterfall texture, a ring of rows like pb.waterfall's, so only
+	// new rows are rasterized and uploaded every frame
+	unsigned int waterfall_texture = 0;
+	uint64_t waterfall_generation = 0;
+	uint64_t waterfall_uploaded = 0;
+	size_t waterfall_rows = 0;
+	size_t waterfall_width = 0;
+	float waterfall_min = -80.0f;
+	float waterfall_max = 0.0f;
+	ImU32 waterfall_lut[256];
+	std::vector<float> waterfall_row;
+	std::vector<ImU32> waterfall_rgba;
+	void update_waterfall_texture();
+
+	// Spectrum, average, max and min reduced to the plot's width
+	Decimator plot_lod[4];
+	void plot_series(const char* label, Decimator& lod, const std::vector<double>& y,
+					 const SpectrumPyramid& pyramid, bool hidden);
 
 	void do_import_menu();
 	void do_export_menu();
+	void do_latency_menu();
 	void do_connection_menu();
 	void do_ranges_menu();
 	void do_display_menu();
@@ -35,5 +62,7 @@ public:
 
 
 	void gui_function();
+	// Call while the graphics context still exists
+	void release_textures();
 	GUI();
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "HopScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+void HopScheduler::configure(double nlow, double nhigh, double nwidth, double nmargin,
+							 size_t nfirst_bin, size_t nbins, int nrevisits)
+{
+	low = nlow;
+	high = nhigh;
+	width = nwidth;
+	margin = nmargin;
+	first_bin = nfirst_bin;
+	bins = nbins;
+	revisits = std::max(nrevisits, 0);
+	num_segments = width > 0.0 ? (size_t)std::max(std::ceil((high - low) / width), 1.0) : 1;
+
+	activity.assign(num_segments, 0.0);
+	planned.clear();
+	next_run = 0;
+	num_busy = 0;
+}
+
+void HopScheduler::update_activity(const double* max, const double* min, size_t n)
+{
+	for(size_t s = 0; s < num_segments; s++)
+	{
+		size_t b0 = std::min(first_bin + s * bins, n);
+		size_t b1 = std::min(b0 + bins, n);
+		double spread = 0.0;
+		for(size_t b = b0; b < b1; b++)
+		{
+			spread += max[b] - min[b];
+		}
+		activity[s] = b1 > b0 ? spread / (b1 - b0) : 0.0;
+	}
+}
+
+HopScheduler::Run HopScheduler::make_run(size_t first_seg, size_t last_seg)
+{
+	Run run;
+	run.min_f = std::max(low + first_seg * width - margin, 0.0);
+	run.max_f = std::min(low + last_seg * width, high) + margin;
+	run.full = first_seg == 0 && last_seg == num_segments;
+	return run;
+}
+
+void HopScheduler::plan()
+{
+	planned.clear();
+	next_run = 0;
+
+	std::vector<double> sorted = activity;
+	std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+	double median = sorted[sorted.size() / 2];
+
+	// The busiest segments above the threshold
+	std::vector<size_t> order(num_segments);
+	for(size_t s = 0; s < num_segments; s++)
+	{
+		order[s] = s;
+	}
+	std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return activity[a] > activity[b]; });
+
+	size_t max_busy = (size_t)(num_segments * max_busy_fraction);
+	std::vector<bool> busy(num_segments, false);
+	num_busy = 0;
+	for(size_t i = 0; i < max_busy; i++)
+	{
+		double a = activity[order[i]];
+		if(a <= 0.0 || a < median * busy_ratio)
+		{
+			break;
+		}
+		busy[order[i]] = true;
+		num_busy++;
+	}
+
+	// Neighbouring busy segments share a run, every run restarts the device
+	std::vector<Run> spans;
+	for(size_t s = 0; s < num_segments; s++)
+	{
+		if(!busy[s])
+		{
+			continue;
+		}
+		size_t e = s;
+		while(e < num_segments && busy[e])
+		{
+			e++;
+		}
+		spans.push_back(make_run(s, e));
+		s = e;
+	}
+
+	for(int r = 0; r < revisits; r++)
+	{
+		planned.insert(planned.end(), spans.begin(), spans.end());
+	}
+	planned.push_back(make_run(0, num_segments));
+}
+
+HopScheduler::Run HopScheduler::next()
+{
+	if(next_run >= planned.size())
+	{
+		plan();
+	}
+	return planned[next_run++];
+}
+
+HopScheduler::HopScheduler()
+{
+	low = 0.0;
+	high = 0.0;
+	width = 0.0;
+	margin = 0.0;
+	first_bin = 0;
+	bins = 0;
+	num_segments = 1;
+	revisits = 0;
+	activity.assign(1, 0.0);
+	next_run = 0;
+	num_busy = 0;
+}
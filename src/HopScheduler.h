@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Plans the rtl_power_fftw runs of one device when sweeping adaptively: a full
+// sweep of its range, then a few sweeps of only its busiest segments (hops), so
+// active channels are revisited more often than quiet ones.
+class HopScheduler
+{
+public:
+	struct Run
+	{
+		// In Hertz, including the overlap margin
+		uint64_t min_f, max_f;
+		// Covers the whole range of the device, otherwise a revisit
+		bool full;
+	};
+
+	// If everything is busy there's nothing to win, so at most this many are revisited
+	static constexpr double max_busy_fraction = 0.25;
+	// Busy segments are at least this much more active than the median one
+	static constexpr double busy_ratio = 1.5;
+
+private:
+	// Segment s covers [low + s * width, low + (s + 1) * width), clipped to high,
+	// and bins [first_bin + s * bins, first_bin + (s + 1) * bins)
+	double low, high, width, margin;
+	size_t first_bin, bins, num_segments;
+	int revisits;
+
+	std::vector<double> activity;
+	std::vector<Run> planned;
+	size_t next_run;
+	size_t num_busy;
+
+	void plan();
+	Run make_run(size_t first_seg, size_t last_seg);
+
+public:
+
+	void configure(double low, double high, double width, double margin,
+				   size_t first_bin, size_t bins, int revisits);
+
+	// Activity of each segment is the mean spread between the max and min of its bins
+	void update_activity(const double* max, const double* min, size_t n);
+
+	// Run to launch after the previous one ended
+	Run next();
+
+	size_t get_num_busy() const { return num_busy; }
+
+	HopScheduler();
+};
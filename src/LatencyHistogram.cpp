@@ -0,0 +1,113 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+size_t LatencyHistogram::get_bucket(uint64_t us)
+{
+	if(us < 4)
+	{
+		return us;
+	}
+	// Power of two, then the two bits below the leading one
+	int e = 63 - __builtin_clzll(us);
+	size_t sub = (us >> (e - 2)) & 3;
+	return (e - 1) * 4 + sub;
+}
+
+uint64_t LatencyHistogram::get_bucket_limit(size_t idx)
+{
+	if(idx < 4)
+	{
+		return idx;
+	}
+	int e = idx / 4 + 1;
+	uint64_t sub = idx % 4;
+	return ((5 + sub) << (e - 2)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration d)
+{
+	int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+	uint64_t value = us < 0 ? 0 : us;
+
+	buckets[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	uint64_t prev = max.load(std::memory_order_relaxed);
+	while(value > prev && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::get_percentile(double p) const
+{
+	uint64_t total = count;
+	if(total == 0)
+	{
+		return 0;
+	}
+
+	uint64_t target = std::max<uint64_t>((uint64_t)std::ceil(p * total), 1);
+	uint64_t seen = 0;
+	for(size_t i = 0; i < num_buckets; i++)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if(seen >= target)
+		{
+			return std::min(get_bucket_limit(i), get_max());
+		}
+	}
+	return get_max();
+}
+
+void LatencyHistogram::reset()
+{
+	for(std::atomic<uint64_t>& bucket : buckets)
+	{
+		bucket = 0;
+	}
+	count = 0;
+	max = 0;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void PipelineLatency::reset()
+{
+	for(LatencyHistogram& stage : stages)
+	{
+		stage.reset();
+	}
+}
+
+bool PipelineLatency::dump(const std::string& fname) const
+{
+	std::ofstream f(fname, std::ios::trunc);
+	if(!f.good())
+	{
+		return false;
+	}
+
+	f << "# stage count p50_us p90_us p99_us max_us" << std::endl;
+	for(size_t s = 0; s < num_stages; s++)
+	{
+		const LatencyHistogram& h = stages[s];
+		f << stage_names[s] << " " << h.get_count() << " " << h.get_percentile(0.5) << " "
+		  << h.get_percentile(0.9) << " " << h.get_percentile(0.99) << " " << h.get_max() << std::endl;
+	}
+
+	f << std::endl << "# stage bucket_limit_us count" << std::endl;
+	for(size_t s = 0; s < num_stages; s++)
+	{
+		for(size_t i = 0; i < LatencyHistogram::num_buckets; i++)
+		{
+			uint64_t n = stages[s].get_bucket_count(i);
+			if(n > 0)
+			{
+				f << stage_names[s] << " " << LatencyHistogram::get_bucket_limit(i) << " " << n << std::endl;
+			}
+		}
+	}
+	return f.good();
+}
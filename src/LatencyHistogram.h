@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Distribution of durations, recorded from any thread without locking and read
+// from any other. Buckets are log scaled with four per power of two of
+// microseconds, so percentiles are within 25% up to hours.
+class LatencyHistogram
+{
+public:
+	static constexpr size_t num_buckets = 256;
+
+private:
+	std::atomic<uint64_t> buckets[num_buckets];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> max;
+
+	static size_t get_bucket(uint64_t us);
+
+public:
+	void record(std::chrono::steady_clock::duration d);
+
+	uint64_t get_count() const { return count; }
+	// In microseconds
+	uint64_t get_max() const { return max; }
+	// In microseconds, the upper end of the bucket holding it. p in [0, 1].
+	uint64_t get_percentile(double p) const;
+	uint64_t get_bucket_count(size_t idx) const { return buckets[idx]; }
+	static uint64_t get_bucket_limit(size_t idx);
+
+	// Values recorded meanwhile may be lost
+	void reset();
+
+	LatencyHistogram();
+};
+
+// How long data spends in each stage between being read from the input and
+// being on screen, per hop up to the worker and per snapshot after it
+struct PipelineLatency
+{
+	enum Stage
+	{
+		// First bytes of the hop read, to the hop being complete
+		assemble,
+		// Queued for the worker
+		queue,
+		// Popped by the worker, to the snapshot including it being published
+		process,
+		// Published, to being picked up by PlotBuilder::update
+		handoff,
+		// Picked up, to drawn by the GUI (written out by the daemon)
+		draw,
+		// Read to drawn, for the newest hop of every drawn snapshot
+		total,
+		num_stages
+	};
+	static constexpr const char* stage_names[num_stages] =
+			{"Assemble", "Queue", "Process", "Hand-off", "Draw", "Total"};
+
+	LatencyHistogram stages[num_stages];
+
+	void reset();
+	// Summary and non empty buckets of every stage as text, false on failure
+	bool dump(const std::string& fname) const;
+};
@@ -13,8 +13,9 @@ int main(void)
 	{
 		ImPlot::CreateContext();
 	};
-	imgui_params.callbacks.BeforeExit = []()
+	imgui_params.callbacks.BeforeExit = [&gui]()
 	{
+		gui.release_textures();
 		ImPlot::DestroyContext();
 	};
 	imgui_params.callbacks.SetupImGuiStyle = []()
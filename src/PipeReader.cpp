@@ -0,0 +1,16 @@
+#include "PipeReader.h"
+
+void PipeReader::reset()
+{
+	// Allocated on first use, idle readers don't hold the buffer
+	buffer.resize(buffer_size);
+	head = 0;
+	tail = 0;
+	rates.reset();
+}
+
+PipeReader::PipeReader()
+{
+	head = 0;
+	tail = 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include "RateMeter.h"
+
+// Reads big blocks from a file descriptor and hands out complete lines as
+// views into its own buffer, so no per-character copying takes place.
+// Lines are kept contiguous by moving the (partial) tail line back to the
+// start of the buffer once the end is reached.
+class PipeReader
+{
+private:
+	std::vector<char> buffer;
+	// Valid, unprocessed data is in [head, tail)
+	size_t head;
+	size_t tail;
+
+public:
+	static constexpr size_t buffer_size = 1 << 20;
+
+	// Also account data read from outside read_from here
+	RateMeter rates;
+
+	// Reads whatever is available in fd and calls on_line(std::string_view) for every
+	// complete line, including its trailing '\n'. The view is only valid during the call.
+	// Returns the number of bytes read, 0 on end of file and -1 on error.
+	template<typename F>
+	ssize_t read_from(int fd, F&& on_line);
+
+	// Call before reading
+	void reset();
+
+	PipeReader();
+};
+
+template<typename F>
+ssize_t PipeReader::read_from(int fd, F&& on_line)
+{
+	if(tail == buffer.size())
+	{
+		if(head == 0)
+		{
+			// A single line doesn't fit the buffer, this is garbage anyway
+			tail = 0;
+		}
+		else
+		{
+			std::memmove(buffer.data(), buffer.data() + head, tail - head);
+			tail -= head;
+			head = 0;
+		}
+	}
+
+	ssize_t nread = read(fd, buffer.data() + tail, buffer.size() - tail);
+	if(nread <= 0)
+	{
+		return nread;
+	}
+
+	// Only the new data may contain unseen newlines
+	const char* scan = buffer.data() + tail;
+	tail += nread;
+	const char* end = buffer.data() + tail;
+	size_t nlines = 0;
+	while(const char* nl = (const char*)std::memchr(scan, '\n', end - scan))
+	{
+		const char* line_start = buffer.data() + head;
+		on_line(std::string_view(line_start, nl + 1 - line_start));
+		head = nl + 1 - buffer.data();
+		scan = nl + 1;
+		nlines++;
+	}
+
+	if(head == tail)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	rates.update(nread, nlines);
+	return nread;
+}
@@ -3,6 +3,10 @@
 #include <cmath>
 #include <limits>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "DspKernels.h"
 
 void PlotBuilder::launch()
 {
@@ -16,45 +20,306 @@ void PlotBuilder::launch()
 	thread_run = true;
 	thread = std::thread([this]()
  	{
+		RTLPowerData hop;
+		Scan sc;
 		while(thread_run)
 		{
-			std::unique_lock<std::mutex> lock(power_wrapper.data_mtx);
-			auto st = power_wrapper.data_available.wait_for(lock,
-												  std::chrono::milliseconds(200));
+			// Restarts are polled, they don't notify
+			wait_for_data(std::chrono::milliseconds(launch_queued ? 10 : 200));
 
-			if(st != std::cv_status::timeout && power_wrapper.data)
+			apply_pending();
+
+			if(launch_queued)
 			{
-				mtx.lock();
-				Scan sc;
-				sc.is_last_of_scan = false;
-				sc.is_first_of_scan = false;
-				sc.reads.insert(sc.reads.end(), power_wrapper.data->reads.begin(), power_wrapper.data->reads.end());
-				if(next_is_first)
-				{
-					sc.is_first_of_scan = true;
-					next_is_first = false;
-				}
-				if(power_wrapper.data->is_end_of_sweep)
+				restart_runs();
+			}
+
+			bool any = false;
+			size_t ndev = num_devices;
+			for(size_t dev = 0; dev < ndev; dev++)
+			{
+				// Sources are only replaced by this thread. At most a queue's worth at
+				// once, or a source that never drops hops would keep us from publishing.
+				SpectrumSource* source = sources[dev].get();
+				size_t budget = source ? source->hops.capacity() : 0;
+				while(budget > 0 && source->hops.pop_swap(hop))
 				{
-					sc.is_last_of_scan = true;
-					next_is_first = true;
+					budget--;
+					// Hops of a run being replaced don't belong to the new settings
+					if(restarting[dev])
+					{
+						continue;
+					}
+
+					auto now = std::chrono::steady_clock::now();
+					latency.stages[PipelineLatency::assemble].record(hop.done_time - hop.read_time);
+					latency.stages[PipelineLatency::queue].record(now - hop.done_time);
+					newest_read = hop.read_time;
+					newest_pop = now;
+
+					// Borrow the hop's storage, it goes back to the wrapper's queue on the next pop
+					sc.reads.swap(hop.reads);
+					sc.device = dev;
+					sc.is_partial = partial_run[dev];
+					sc.is_last_of_scan = false;
+					sc.is_first_of_scan = false;
+					if(next_is_first[dev])
+					{
+						sc.is_first_of_scan = true;
+						next_is_first[dev] = false;
+					}
+					if(hop.is_end_of_sweep)
+					{
+						sc.is_last_of_scan = true;
+						next_is_first[dev] = true;
+					}
+					accumulate(sc);
+					if(sc.is_last_of_scan && !sc.is_partial)
+					{
+						// The stitched sweep is complete once every device went through its part
+						sweeps_done |= 1u << dev;
+						if(sweeps_done == (1u << ndev) - 1)
+						{
+							waterfall.append(work.spectrum.data(), work.spectrum.size());
+							sweeps_done = 0;
+						}
+					}
+					sc.reads.swap(hop.reads);
+					any = true;
 				}
-				reads_buffer.push_back(sc);
-				mtx.unlock();
-				power_wrapper.data = nullptr;
 			}
 
-			if(launch_queued)
+			if(any)
 			{
-				if(power_wrapper.is_stopped())
+				publish();
+			}
+
+			if(!launch_queued)
+			{
+				supervise_runs();
+			}
+		}
+	});
+}
+
+void PlotBuilder::restart_runs()
+{
+	std::lock_guard<std::mutex> lock(wrapper_mtx);
+	size_t ndev = num_devices;
+
+	// Once per commit, decide which runs can stay. Restarting the others takes
+	// a while (the device is reopened) so it's polled without blocking.
+	if(handled_commit != commit_count)
+	{
+		handled_commit = commit_count;
+		for(size_t dev = 0; dev < max_devices; dev++)
+		{
+			restarting[dev] = false;
+			next_is_first[dev] = true;
+			partial_run[dev] = false;
+
+			SpectrumSource* source = sources[dev].get();
+			if(dev < ndev && source && source->get_kind() == work_source)
+			{
+				source->set_config(device_configs[dev]);
+				if(source->can_keep_running())
 				{
-					power_wrapper.launch();
-					launch_queued = false;
-					next_is_first = true;
+					continue;
 				}
 			}
+			if(source)
+			{
+				source->request_stop();
+			}
+			restarting[dev] = dev < ndev;
 		}
-	});
+		sweeps_done = 0;
+	}
+
+	bool pending = false;
+	for(size_t dev = 0; dev < ndev; dev++)
+	{
+		if(!restarting[dev])
+		{
+			continue;
+		}
+
+		SpectrumSource* source = sources[dev].get();
+		if(source && !source->reap())
+		{
+			pending = true;
+			continue;
+		}
+
+		if(!source || source->get_kind() != work_source)
+		{
+			sources[dev] = SpectrumSource::create(work_source);
+			sources[dev]->set_data_notify(&data_available);
+		}
+		else
+		{
+			RTLPowerData hop;
+			while(source->hops.pop_swap(hop)) {}
+		}
+		sources[dev]->set_config(device_configs[dev]);
+		sources[dev]->launch();
+		restarting[dev] = false;
+	}
+
+	if(!pending)
+	{
+		run_active = true;
+		launch_queued = false;
+	}
+}
+
+void PlotBuilder::supervise_runs()
+{
+	std::lock_guard<std::mutex> lock(wrapper_mtx);
+	// Collect runs that ended by themselves or were stopped
+	for(std::unique_ptr<SpectrumSource>& source : sources)
+	{
+		if(source && source->is_stopped())
+		{
+			source->reap();
+		}
+	}
+
+	if(!work_adaptive || !run_active || launch_queued)
+	{
+		return;
+	}
+
+	size_t busy = 0;
+	for(size_t dev = 0; dev < num_devices; dev++)
+	{
+		SpectrumSource* source = sources[dev].get();
+		// Hops may still be queued right after it stopped
+		if(source && source->is_stopped() && source->hops.empty() && source->reap())
+		{
+			HopScheduler& scheduler = schedulers[dev];
+			scheduler.update_activity(work.max.data(), work.min.data(),
+									  std::min(work.max.size(), work.min.size()));
+			HopScheduler::Run run = scheduler.next();
+
+			source->set_freq_range(run.min_f, run.max_f);
+			source->launch();
+			next_is_first[dev] = true;
+			partial_run[dev] = !run.full;
+		}
+		busy += schedulers[dev].get_num_busy();
+	}
+	busy_segments = busy;
+}
+
+void PlotBuilder::apply_pending()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	bool changed = false;
+
+	if(pending_settings_changed)
+	{
+		work.settings = pending_settings;
+		// Clear points
+		work.spectrum.clear();
+		work.spectrum.resize(std::ceil(work.get_number_of_scans() * work.settings.nbins));
+		raw_spectrum.assign(work.spectrum.size(), 0.0);
+		waterfall.resize(work.spectrum.size(), Waterfall::default_rows);
+		pending_settings_changed = false;
+		changed = true;
+	}
+
+	if(pending_averaging_changed)
+	{
+		work_averaging = pending_averaging;
+		reset_averaging();
+		pending_averaging_changed = false;
+		changed = true;
+	}
+
+	if(pending_baseline_changed)
+	{
+		work_baseline = std::move(pending_baseline);
+		pending_baseline_changed = false;
+	}
+	work_baseline_mode = pending_baseline_mode;
+
+	// So the GUI never shows data of the previous settings for long
+	if(changed)
+	{
+		work.rebuild_pyramids();
+		publish();
+	}
+}
+
+void PlotBuilder::publish()
+{
+	// Assignment reuses the storage of the old snapshot, so this doesn't allocate
+	Measurement& snap = snapshots.get_back();
+	snap.settings = work.settings;
+	snap.spectrum = work.spectrum;
+	snap.average = work.average;
+	snap.max = work.max;
+	snap.min = work.min;
+	snap.spectrum_pyramid = work.spectrum_pyramid;
+	snap.average_pyramid = work.average_pyramid;
+	snap.max_pyramid = work.max_pyramid;
+	snap.min_pyramid = work.min_pyramid;
+	snap.numScans = work.numScans;
+	snap.stepFreq = work.stepFreq;
+
+	// Snapshots without new hops (settings changes) don't count
+	auto now = std::chrono::steady_clock::now();
+	snap.publish_time = now;
+	snap.newest_read_time = newest_read;
+	if(newest_pop != std::chrono::steady_clock::time_point())
+	{
+		latency.stages[PipelineLatency::process].record(now - newest_pop);
+	}
+	newest_read = std::chrono::steady_clock::time_point();
+	newest_pop = std::chrono::steady_clock::time_point();
+	snapshots.publish();
+}
+
+void PlotBuilder::update()
+{
+	if(snapshots.consume(current))
+	{
+		current_version++;
+		merged_time = std::chrono::steady_clock::now();
+		latency.stages[PipelineLatency::handoff].record(merged_time - current.publish_time);
+		draw_pending = true;
+	}
+
+	mtx.lock();
+	pending_baseline_mode = baseline_mode;
+	mtx.unlock();
+}
+
+void PlotBuilder::mark_drawn()
+{
+	if(!draw_pending)
+	{
+		return;
+	}
+	draw_pending = false;
+
+	auto now = std::chrono::steady_clock::now();
+	latency.stages[PipelineLatency::draw].record(now - merged_time);
+	if(current.newest_read_time != std::chrono::steady_clock::time_point())
+	{
+		latency.stages[PipelineLatency::total].record(now - current.newest_read_time);
+	}
+}
+
+void PlotBuilder::set_baseline(const std::optional<Measurement>& nbaseline)
+{
+	baseline = nbaseline;
+
+	mtx.lock();
+	pending_baseline = nbaseline.has_value() ? std::make_shared<const Measurement>(nbaseline.value()) : nullptr;
+	pending_baseline_changed = true;
+	mtx.unlock();
 }
 
 PlotBuilder::PlotBuilder()
@@ -70,16 +335,53 @@ PlotBuilder::PlotBuilder()
 	exposed.nsamples = 20;
 	exposed.samp_rate = 2e6;
 
-	next_is_first = true;
+	for(size_t dev = 0; dev < max_devices; dev++)
+	{
+		next_is_first[dev] = true;
+		partial_run[dev] = false;
+		restarting[dev] = false;
+	}
+	num_devices = 1;
+	sweeps_done = 0;
+	devices[0] = '\0';
+	iq_file[0] = '\0';
+	draw_pending = false;
+	std::strcpy(power_command, "rtl_power_fftw");
+	replay_file[0] = '\0';
+	tones[0] = '\0';
+	hop_rate = 0.0f;
+	source_kind = SourceKind::rtl_power_fftw;
+	work_source = source_kind;
+	adaptive_sweep = false;
+	adaptive_revisits = 3;
+	work_adaptive = false;
+	run_active = false;
+	busy_segments = 0;
+	commit_count = 0;
+	handled_commit = 0;
+	current_version = 0;
 
 	thread_run = false;
 	launch_queued = false;
+	binary_transfer = false;
+
+	pending_settings_changed = false;
+	pending_baseline_changed = false;
+	work_averaging = {};
+	measurement_count = 0;
+	history_memory = 0;
 
-	num_average_hold = 20;
+	averaging.mode = 0;
+	averaging.history = 20;
+	averaging.time_constant = 20.0f;
+	averaging.peak_decay = 0.1f;
+	averaging.linear = false;
 	update_averaging();
 
 	// Average
 	baseline_mode = 1;
+	pending_baseline_mode = baseline_mode;
+	work_baseline_mode = baseline_mode;
 
 
 }
@@ -94,31 +396,228 @@ void PlotBuilder::commit_settings()
 
 	current.settings = exposed;
 
-	power_wrapper.stop();
+	// Nothing is stopped here, the worker restarts whatever can't keep running
+	std::lock_guard<std::mutex> lock(wrapper_mtx);
+
+	// Each device gets a contiguous run of hops, aligned to the hops a single
+	// device would make, and the worker stitches them by frequency
+	std::vector<std::string> devs = parse_devices();
+	size_t nhops = std::max(current.get_number_of_scans(), (size_t)1);
+	size_t ndev = std::min(std::max(devs.size(), (size_t)1), nhops);
+	// A recording can't be split by range, nor revisited in parts
+	bool replay = source_kind == SourceKind::replay;
+	if(replay)
+	{
+		ndev = 1;
+	}
+	std::vector<uint64_t> tone_freqs = parse_tones();
+	std::string command = power_command;
+	if(command.find_first_not_of(" \t") == std::string::npos)
+	{
+		command = "rtl_power_fftw";
+	}
+	double low = current.get_freq(current.settings.min_freq, current.settings.min_freq_units);
+	double high = current.get_freq(current.settings.max_freq, current.settings.max_freq_units);
 	// We oversample a bit to prevent "overlap" from behaving weirdly
-	power_wrapper.set_freq_range(
-			current.get_freq(current.settings.min_freq, current.settings.min_freq_units) -
-					(current.settings.percent / 100.0) * current.settings.samp_rate,
-			current.get_freq(current.settings.max_freq, current.settings.max_freq_units) +
-					(current.settings.percent / 100.0) * current.settings.samp_rate);
-	power_wrapper.set_num_bins(current.settings.nbins);
-	power_wrapper.set_overlap(current.settings.percent);
-	power_wrapper.set_num_samples(current.settings.nsamples);
+	double margin = (current.settings.percent / 100.0) * current.settings.samp_rate;
+	for(size_t dev = 0; dev < ndev; dev++)
+	{
+		double dev_low = low + (double)(nhops * dev / ndev) * current.settings.samp_rate;
+		double dev_high = dev + 1 == ndev ? high : low + (double)(nhops * (dev + 1) / ndev) * current.settings.samp_rate;
 
-	power_wrapper.set_gain((int)(current.settings.gain * 10.0));
+		RTLPowerConfig& cfg = device_configs[dev];
+		cfg.min_f = dev_low - margin;
+		cfg.max_f = dev_high + margin;
+		cfg.nbins = current.settings.nbins;
+		cfg.overlap_percent = current.settings.percent;
+		cfg.snum = current.settings.nsamples;
+		cfg.use_stime = false;
 
-	launch_queued = true;
+		cfg.gain = (int)(current.settings.gain * 10.0);
+		cfg.samp_rate = current.settings.samp_rate;
+		cfg.binary = binary_transfer;
+		cfg.device = devs.empty() ? "" : devs[dev];
+		cfg.continuous = !adaptive_sweep || replay;
+		cfg.iq_file = iq_file;
+		cfg.command = command;
+		cfg.replay_file = replay_file;
+		cfg.tones = tone_freqs;
+		cfg.hop_rate = std::max(hop_rate, 0.0f);
 
-	// Clear points
+		// Bins of the device start at its first hop
+		size_t first_bin = (nhops * dev / ndev) * current.settings.nbins;
+		schedulers[dev].configure(dev_low, dev_high, current.settings.samp_rate, margin,
+								  first_bin, current.settings.nbins, adaptive_revisits);
+	}
+	num_devices = ndev;
+	work_source = source_kind;
+	work_adaptive = adaptive_sweep && !replay;
+	busy_segments = 0;
+	commit_count++;
+
+	// The worker resets its data, until then show an empty spectrum
+	current_version++;
 	current.spectrum.clear();
 	current.spectrum.resize(std::ceil(current.get_number_of_scans() * current.settings.nbins));
+	current.average.assign(current.spectrum.size(), 0.0);
+	current.max.assign(current.spectrum.size(), 0.0);
+	current.min.assign(current.spectrum.size(), 0.0);
+
+	mtx.lock();
+	pending_settings = current.settings;
+	pending_settings_changed = true;
+	mtx.unlock();
 	update_averaging();
+
+	launch_queued = true;
 }
 
 void PlotBuilder::stop()
 {
-	power_wrapper.stop();
+	// Doesn't wait for the runs to end, the worker reaps them
+	std::lock_guard<std::mutex> lock(wrapper_mtx);
+	for(std::unique_ptr<SpectrumSource>& source : sources)
+	{
+		if(source)
+		{
+			source->request_stop();
+		}
+	}
 	launch_queued = false;
+	run_active = false;
+}
+
+void PlotBuilder::wait_for_data(std::chrono::milliseconds timeout)
+{
+	// Sources notify without locking, a missed wake up only costs one timeout
+	std::unique_lock<std::mutex> lock(data_mtx);
+	data_available.wait_for(lock, timeout, [this]()
+	{
+		for(size_t dev = 0; dev < num_devices; dev++)
+		{
+			if(sources[dev] && !sources[dev]->hops.empty())
+				return true;
+		}
+		return false;
+	});
+}
+
+std::vector<std::string> PlotBuilder::parse_devices()
+{
+	// The command goes through the shell, so only plain indices / serials are accepted
+	std::vector<std::string> out;
+	std::stringstream s(devices);
+	std::string dev;
+	while(std::getline(s, dev, ','))
+	{
+		dev.erase(std::remove_if(dev.begin(), dev.end(), [](char c) { return std::isspace((unsigned char)c); }), dev.end());
+		if(dev.empty())
+			continue;
+
+		bool valid = std::all_of(dev.begin(), dev.end(), [](char c)
+		{
+			return std::isalnum((unsigned char)c) || c == '-' || c == '_';
+		});
+		if(!valid)
+		{
+			std::cerr << "Ignoring invalid device " << dev << std::endl;
+			continue;
+		}
+		if(out.size() == max_devices)
+		{
+			std::cerr << "Only " << max_devices << " devices are supported" << std::endl;
+			break;
+		}
+		out.push_back(dev);
+	}
+	return out;
+}
+
+std::vector<uint64_t> PlotBuilder::parse_tones()
+{
+	// Comma separated, in MHz
+	std::vector<uint64_t> out;
+	std::stringstream s(tones);
+	std::string tone;
+	while(std::getline(s, tone, ','))
+	{
+		char* end;
+		double mhz = std::strtod(tone.c_str(), &end);
+		if(end == tone.c_str() || mhz <= 0.0)
+		{
+			if(tone.find_first_not_of(" \t") != std::string::npos)
+				std::cerr << "Ignoring invalid tone " << tone << std::endl;
+			continue;
+		}
+		out.push_back((uint64_t)(mhz * 1e6));
+	}
+	return out;
+}
+
+bool PlotBuilder::get_power_status()
+{
+	// True if any device is not running
+	bool not_running = num_devices == 0;
+	for_each_source([&](SpectrumSource& source) { not_running = not_running || source.get_exec_status(); });
+	return not_running;
+}
+
+double PlotBuilder::get_pipe_bytes_per_second()
+{
+	double sum = 0.0;
+	for_each_source([&](SpectrumSource& source) { sum += source.get_bytes_per_second(); });
+	return sum;
+}
+
+double PlotBuilder::get_pipe_lines_per_second()
+{
+	double sum = 0.0;
+	for_each_source([&](SpectrumSource& source) { sum += source.get_lines_per_second(); });
+	return sum;
+}
+
+uint64_t PlotBuilder::get_hops_received()
+{
+	uint64_t sum = 0;
+	for_each_source([&](SpectrumSource& source) { sum += source.hops.get_pushed(); });
+	return sum;
+}
+
+uint64_t PlotBuilder::get_hops_dropped()
+{
+	uint64_t sum = 0;
+	for_each_source([&](SpectrumSource& source) { sum += source.hops.get_dropped(); });
+	return sum;
+}
+
+size_t PlotBuilder::get_hops_queued()
+{
+	size_t sum = 0;
+	for_each_source([&](SpectrumSource& source) { sum += source.hops.size(); });
+	return sum;
+}
+
+size_t PlotBuilder::get_hops_high_water()
+{
+	// Of the fullest queue, which is the one that overflows first
+	size_t high = 0;
+	for_each_source([&](SpectrumSource& source) { high = std::max(high, source.hops.get_high_water()); });
+	return high;
+}
+
+size_t PlotBuilder::get_hops_capacity()
+{
+	// Per device, they're all the same
+	size_t capacity = 0;
+	for_each_source([&](SpectrumSource& source) { capacity = source.hops.capacity(); });
+	return capacity;
+}
+
+uint64_t PlotBuilder::get_allocations()
+{
+	uint64_t sum = 0;
+	for_each_source([&](SpectrumSource& source) { sum += source.get_allocations(); });
+	return sum;
 }
 
 size_t Measurement::get_number_of_scans()
@@ -138,7 +637,14 @@ double Measurement::get_bin_center_freq(size_t idx)
 
 size_t Measurement::get_bin_for_freq(double freq)
 {
-	return std::round((freq - get_low_freq()) / get_hertz_per_bin());
+	// Readouts below the range (overlap margin, or a process kept running with
+	// a wider range) must not end up in the first bin
+	double bin = std::round((freq - get_low_freq()) / get_hertz_per_bin());
+	if(bin < 0.0)
+	{
+		return std::numeric_limits<size_t>::max();
+	}
+	return bin;
 }
 
 int64_t Measurement::get_freq(float val, int units)
@@ -167,73 +673,140 @@ bool PlotBuilder::can_change_settings()
 PlotBuilder::~PlotBuilder()
 {
 	thread_run = false;
-	thread.join();
+	if(thread.joinable())
+	{
+		thread.join();
+	}
+
+	// Their threads notify data_available, which would otherwise go first
+	for(std::unique_ptr<SpectrumSource>& source : sources)
+	{
+		source.reset();
+	}
 }
 
-void PlotBuilder::update()
+void PlotBuilder::accumulate(const Scan& sc)
 {
-	mtx.lock();
-	for(const auto& sc : reads_buffer)
+	// Every bin gets one reading per stitched sweep, which the first device starts
+	if(sc.is_first_of_scan && sc.device == 0 && !sc.is_partial)
 	{
-		if(sc.is_first_of_scan)
+		if(measurement_count < work_averaging.history)
 		{
-			if(measurement_count < num_average_hold)
-			{
-				measurement_count++;
-			}
+			measurement_count++;
 		}
-		for (size_t i = 0; i < sc.reads.size(); i++)
+	}
+
+	// Preserve only upper percent of scan
+	int num_skip_below = (work.settings.nbins * work.settings.percent) / 100;
+	// Upper side will be overwritten by next one anyway, so don't write it!
+	// First scan of sweep cannot be clipped!
+	if (sc.is_first_of_scan || num_skip_below < 0)
+	{
+		num_skip_below = 0;
+	}
+
+	bool exponential = work_averaging.mode == 1;
+	bool averaging = exponential || work_averaging.history > 0;
+	bool linear = averaging && work_averaging.linear;
+
+	if(linear)
+	{
+		hop_power.resize(sc.reads.size());
+		for(size_t i = 0; i < sc.reads.size(); i++)
 		{
-			size_t bin = current.get_bin_for_freq(sc.reads[i].freq);
-			// Preserve only upper percent of scan
-			int num_skip_below = (current.settings.nbins * current.settings.percent) / 100;
-			// Upper side will be overwritten by next one anyway, so don't write it!
-			// First scan of sweep cannot be clipped!
-			if (sc.is_first_of_scan)
+			hop_power[i] = sc.reads[i].power;
+		}
+		dsp::db_to_linear(hop_power.data(), hop_power.data(), hop_power.size());
+	}
+
+	// Bins touched by this hop, which are then finished all at once
+	size_t first = std::numeric_limits<size_t>::max();
+	size_t last = 0;
+	for (size_t i = num_skip_below; i < sc.reads.size(); i++)
+	{
+		size_t bin = work.get_bin_for_freq(sc.reads[i].freq);
+		if (bin < raw_spectrum.size())
+		{
+			raw_spectrum[bin] = sc.reads[i].power;
+			double value = linear ? hop_power[i] : sc.reads[i].power;
+			if(exponential)
 			{
-				num_skip_below = 0;
+				exp_stats.push(bin, value);
 			}
-			if (i >= num_skip_below && bin <= current.spectrum.size() - 1)
+			else if(averaging)
 			{
-				current.spectrum[bin] = sc.reads[i].power;
-
-				if(measurement_count > 0)
-				{
-					// Insert current measurement to FIFO
-					prev_measurements[measurement_count - 1][bin] = current.spectrum[bin];
+				stats.push(bin, value);
+			}
+			first = std::min(first, bin);
+			last = std::max(last, bin + 1);
+		}
+	}
 
-					// Move back FIFO for this sample
-					for (int j = 0; j < measurement_count - 1; j++)
-					{
-						prev_measurements[j][bin] = prev_measurements[j + 1][bin];
-					}
+	if(first >= last)
+	{
+		return;
+	}
+	size_t n = last - first;
 
-					// Current value is average of all in array
-					current.average[bin] = 0;
-					current.max[bin] = -9999;
-					current.min[bin] = 9999;
-					for (int j = 0; j < measurement_count; j++)
-					{
-						current.average[bin] += prev_measurements[j][bin];
-						current.max[bin] = std::max(prev_measurements[j][bin], current.max[bin]);
-						current.min[bin] = std::min(prev_measurements[j][bin], current.min[bin]);
-					}
-					current.average[bin] /= measurement_count;
+	if(exponential)
+	{
+		exp_stats.get_range(first, last, &work.average[first], &work.max[first], &work.min[first]);
+	}
+	else if(averaging)
+	{
+		stats.get_range(first, last, &work.average[first], &work.max[first], &work.min[first]);
+	}
 
-				}
+	if(linear)
+	{
+		// get_range skips bins without values, which already hold dB
+		for_each_stats_run(first, last, [this](size_t a, size_t b)
+		{
+			dsp::linear_to_db(&work.average[a], &work.average[a], b - a);
+			dsp::linear_to_db(&work.max[a], &work.max[a], b - a);
+			dsp::linear_to_db(&work.min[a], &work.min[a], b - a);
+		});
+	}
 
-				if(has_baseline())
-				{
-					current.spectrum[bin] -= baseline.value().get_baseline_bin(baseline_mode)[bin];
-					current.max[bin] -= baseline.value().get_baseline_bin(baseline_mode)[bin];
-					current.min[bin] -= baseline.value().get_baseline_bin(baseline_mode)[bin];
-					current.average[bin] -= baseline.value().get_baseline_bin(baseline_mode)[bin];
-				}
-			}
+	// Only values just recomputed get the baseline subtracted: the spectrum from
+	// raw_spectrum, and the statistics get_range wrote. Bins it skipped were
+	// already subtracted and must not be again.
+	if(work_has_baseline())
+	{
+		const double* base = work_baseline->get_baseline_bin(work_baseline_mode).data();
+		dsp::subtract(&work.spectrum[first], &raw_spectrum[first], base + first, n);
+		if(averaging)
+		{
+			for_each_stats_run(first, last, [this, base](size_t a, size_t b)
+			{
+				dsp::subtract(&work.average[a], &work.average[a], base + a, b - a);
+				dsp::subtract(&work.max[a], &work.max[a], base + a, b - a);
+				dsp::subtract(&work.min[a], &work.min[a], base + a, b - a);
+			});
 		}
 	}
-	reads_buffer.clear();
-	mtx.unlock();
+	else
+	{
+		std::copy(raw_spectrum.begin() + first, raw_spectrum.begin() + last, work.spectrum.begin() + first);
+	}
+
+	work.update_pyramids(first, last);
+}
+
+void Measurement::update_pyramids(size_t first, size_t last)
+{
+	spectrum_pyramid.update(spectrum.data(), first, last);
+	average_pyramid.update(average.data(), first, last);
+	max_pyramid.update(max.data(), first, last);
+	min_pyramid.update(min.data(), first, last);
+}
+
+void Measurement::rebuild_pyramids()
+{
+	spectrum_pyramid.rebuild(spectrum);
+	average_pyramid.rebuild(average);
+	max_pyramid.rebuild(max);
+	min_pyramid.rebuild(min);
 }
 
 double Measurement::get_high_freq()
@@ -327,9 +900,22 @@ void Measurement::from_binFile_meta(const std::string& fname, Measurement& binar
 	binaryData.settings.min_freq = std::stoi(metaData.at("startFreq"));
 	binaryData.settings.max_freq = std::stoi(metaData.at("endFreq"));
 	binaryData.settings.nbins    = std::stoi(metaData.at("frequency"));
-	binaryData.stepFreq          = std::stoi(metaData.at("stepFreq"));
+	binaryData.stepFreq          = std::stod(metaData.at("stepFreq"));
 	binaryData.numScans = std::stoi(metaData.at("scans")); 
 
+	// stepFreq may be rounded to whole Hertz, which adds up over thousands of
+	// columns. If it doesn't match the range it's derived from it instead.
+	if(binaryData.settings.nbins > 1)
+	{
+		double start = std::stod(metaData.at("startFreq"));
+		double end = std::stod(metaData.at("endFreq"));
+		double span = end - start;
+		if(std::abs(binaryData.stepFreq * (binaryData.settings.nbins - 1) - span) > 1.0)
+		{
+			binaryData.stepFreq = span / (binaryData.settings.nbins - 1);
+		}
+	}
+
 	// Set default settings
 	binaryData.settings.min_freq_units = 0;
 	binaryData.settings.max_freq_units = 0;
@@ -339,7 +925,7 @@ void Measurement::from_binFile_meta(const std::string& fname, Measurement& binar
 
 	// hertz_per_bin = (double)settings.samp_rate / (double)settings.nbins;
 	// Calculate sample_rate based on information from metafile 
-	binaryData.settings.samp_rate      = binaryData.stepFreq * binaryData.settings.nbins; //2e6;
+	binaryData.settings.samp_rate      = (int)std::lround(binaryData.stepFreq * binaryData.settings.nbins); //2e6;
 
 	// Clear all previous measurements
 	binaryData.spectrum.clear();
@@ -371,36 +957,35 @@ void Measurement::from_binFile_raw(const std::string& fname, Measurement& binary
 		throw std::runtime_error("Cannot open *.bin file: " + fname);
 	}
 	 
-	double f;
 	std::vector<float> buf((binaryData.numScans * binaryData.settings.nbins));    // create buffer
 	bin_file.read(reinterpret_cast<char*>(buf.data()), buf.size()*sizeof(float)); // read all binary data from file to buffer
 
-	double meas;
+	size_t nbins = binaryData.settings.nbins;
 	for( size_t n = 0; n < binaryData.numScans; n++ )
 	{
 		std::cout << "Scan load: "<< n << std::endl;
-		for( size_t i = 0; i < binaryData.settings.nbins; i++ )
-		{	
-			meas = buf[i+(n * binaryData.settings.nbins)];
-			binaryData.spectrum[i] = meas;
-			if ( n==0 ) // calculate avarage based on first scan
-			{
-				binaryData.average[i] = meas;
-				binaryData.max[i] = meas;
-				binaryData.min[i] = meas;
-			} else {
-				binaryData.average[i] += meas ;
-				binaryData.max[i] = std::max(meas, binaryData.max[i]);
-				binaryData.min[i] = std::min(meas, binaryData.min[i]);
-			}
+		dsp::widen(binaryData.spectrum.data(), buf.data() + n * nbins, nbins);
+		if ( n==0 ) // calculate avarage based on first scan
+		{
+			binaryData.average = binaryData.spectrum;
+			binaryData.max = binaryData.spectrum;
+			binaryData.min = binaryData.spectrum;
+		} else {
+			dsp::add(binaryData.average.data(), binaryData.spectrum.data(), nbins);
+			dsp::max(binaryData.max.data(), binaryData.spectrum.data(), nbins);
+			dsp::min(binaryData.min.data(), binaryData.spectrum.data(), nbins);
 		}
 	}
-		
-	for( size_t i = 0; i < binaryData.settings.nbins; i++ )
+
+	if( binaryData.numScans > 0 )
 	{
-		binaryData.average[i] /= binaryData.numScans ;
+		dsp::scale(binaryData.average.data(), 1.0 / binaryData.numScans, nbins);
 	}
-		
+}
+
+const std::vector<double>& Measurement::get_baseline_bin(int baseline_mode) const
+{
+	return const_cast<Measurement*>(this)->get_baseline_bin(baseline_mode);
 }
 
 std::vector<double>& Measurement::get_baseline_bin(int baseline_mode)
@@ -417,20 +1002,47 @@ std::vector<double>& Measurement::get_baseline_bin(int baseline_mode)
 
 void PlotBuilder::update_averaging()
 {
-	prev_measurements.clear();
-	prev_measurements.resize(num_average_hold);
-	for(size_t i = 0; i < num_average_hold; i++)
+	mtx.lock();
+	pending_averaging = averaging;
+	pending_averaging_changed = true;
+	mtx.unlock();
+}
+
+void PlotBuilder::reset_averaging()
+{
+	if(work_averaging.history < 0)
 	{
-		prev_measurements[i].resize(current.spectrum.size());
+		work_averaging.history = 0;
 	}
 
-	current.average.clear();
-	current.average.resize(current.spectrum.size());
-	current.max.resize(current.spectrum.size());
-	current.min.resize(current.spectrum.size());
+	// Only the selected mode holds memory
+	if(work_averaging.mode == 1)
+	{
+		stats.resize(0, 0);
+		exp_stats.resize(work.spectrum.size(), work_averaging.time_constant, work_averaging.peak_decay,
+						 work_averaging.linear);
+		history_memory = exp_stats.get_memory_use();
+	}
+	else
+	{
+		exp_stats.resize(0, 1.0, 0.0, false);
+		stats.resize(work.spectrum.size(), work_averaging.history);
+		history_memory = stats.get_memory_use();
+	}
+
+	work.average.clear();
+	work.average.resize(work.spectrum.size());
+	work.max.resize(work.spectrum.size());
+	work.min.resize(work.spectrum.size());
 	measurement_count = 0;
 }
 
+bool PlotBuilder::work_has_baseline()
+{
+	return work_baseline && (work_baseline->settings == work.settings) &&
+		work_baseline->get_baseline_bin(work_baseline_mode).size() >= work.spectrum.size();
+}
+
 bool PlotBuilder::has_baseline()
 {
 	return baseline.has_value() && (baseline.value().settings == current.settings);
@@ -1,10 +1,24 @@
 #pragma once
-#include "RTLPowerWrapper.h"
+#include "SpectrumSource.h"
+#include "LatencyHistogram.h"
 //#include <map>
 #include <regex>
 #include <fstream>
 #include <unordered_map>
 #include <optional>
+#include <memory>
+#include "TripleBuffer.h"
+#include "RunningStats.h"
+#include "Waterfall.h"
+#include "SpectrumPyramid.h"
+#include "HopScheduler.h"
+
+// Storage type of the averaging history, float halves its memory
+#ifdef RTLPOWERGUI_FLOAT_HISTORY
+using HistorySample = float;
+#else
+using HistorySample = double;
+#endif
 
 struct Settings
 {
@@ -28,11 +42,30 @@ struct Settings
 	bool operator==(const Settings& b) const;
 };
 
+struct AveragingSettings
+{
+	// 0 = Boxcar over the last history values of each bin
+	// 1 = Exponential moving average, with peak / valley hold decaying by peak_decay dB
+	int mode;
+	int history;
+	// In readings of each bin
+	float time_constant;
+	// dB per reading
+	float peak_decay;
+	// Average linear power (mW) instead of dB values, which is the physically
+	// meaningful mean. Results are still shown in dB.
+	bool linear;
+};
+
 struct Scan
 {
 	std::vector<Readout> reads;
 	bool is_first_of_scan;
 	bool is_last_of_scan;
+	// Which of the devices sweeping in parallel produced it, each covers part of the range
+	size_t device;
+	// From a revisit of a few busy segments, not a whole sweep
+	bool is_partial;
 };
 
 
@@ -44,7 +77,21 @@ struct Measurement
 	std::vector<double> max;
 	std::vector<double> min;
 	int numScans = 0;
-	int stepFreq = 0;
+	double stepFreq = 0.0;
+
+	// Of snapshots: when the newest hop in it was read and when it was
+	// published, for latency statistics
+	std::chrono::steady_clock::time_point newest_read_time;
+	std::chrono::steady_clock::time_point publish_time;
+
+	// Reductions of the series above for plotting, keep them in sync after
+	// changing the series with update_pyramids / rebuild_pyramids
+	SpectrumPyramid spectrum_pyramid;
+	SpectrumPyramid average_pyramid;
+	SpectrumPyramid max_pyramid;
+	SpectrumPyramid min_pyramid;
+	void update_pyramids(size_t first, size_t last);
+	void rebuild_pyramids();
 
 	double get_bin_center_freq(size_t idx);
 	size_t get_bin_for_freq(double freq);
@@ -63,6 +110,7 @@ struct Measurement
 	static void from_binFile_raw(const std::string& fname, Measurement& raw);
 
 	std::vector<double>& get_baseline_bin(int baseline_mode);
+	const std::vector<double>& get_baseline_bin(int baseline_mode) const;
 };
 
 struct Measure
@@ -76,20 +124,56 @@ struct Measure
 
 // Runs in a thread to build the raw plots for ImGui
 // with no blocking
-// and uses the RTLPowerWrapper to get its data
+// and uses SpectrumSources (rtl_power_fftw or the in-process engine) to get its data
 // Basically the whole application except GUI is here
 class PlotBuilder
 {
+public:
+	static constexpr size_t max_devices = 8;
+
 private:
-	RTLPowerWrapper power_wrapper;
+	// One per device, each sweeping its own part of the range. Only the first
+	// num_devices are used. Created and replaced by the worker when the kind of
+	// source changes, other threads only touch them with wrapper_mtx held.
+	std::unique_ptr<SpectrumSource> sources[max_devices];
+	std::atomic<size_t> num_devices;
+	// Every source notifies this one
+	std::condition_variable data_available;
+	std::mutex data_mtx;
+	void wait_for_data(std::chrono::milliseconds timeout);
+	std::vector<std::string> parse_devices();
+	std::vector<uint64_t> parse_tones();
+
 	std::thread thread;
-	bool thread_run;
+	std::atomic<bool> thread_run;
 	// We neatly subdivide the freq spectrum, and round samples
 	// (this will nearly never be an issue)
 
-	std::mutex mtx;
-	std::vector<Scan> reads_buffer;
-	std::atomic<bool> next_is_first;
+	// Owned by the worker, per device
+	bool next_is_first[max_devices];
+	// Devices which finished a sweep since the last waterfall row, as bits
+	uint32_t sweeps_done;
+
+	// The worker (re)launches the sources, so the sources, their configuration
+	// and the schedulers are only touched with wrapper_mtx held
+	std::mutex wrapper_mtx;
+	RTLPowerConfig device_configs[max_devices];
+	SourceKind work_source;
+	template<typename F>
+	void for_each_source(F&& f);
+	HopScheduler schedulers[max_devices];
+	bool partial_run[max_devices];
+	bool work_adaptive;
+	// Cleared by stop(), so the worker doesn't relaunch
+	bool run_active;
+	// Increased by commit_settings, the worker handles every commit once
+	uint64_t commit_count;
+	uint64_t handled_commit;
+	// Waiting for the old process to quit before launching, worker owned
+	bool restarting[max_devices];
+	void restart_runs();
+	// Reaps finished processes, and relaunches them when sweeping adaptively
+	void supervise_runs();
 
 	double bandwidths[4] =
 			{
@@ -98,43 +182,171 @@ private:
 			2e6
 			};
 
+	// Owned by the worker thread, which accumulates every hop in here and
+	// publishes a copy for the GUI thread through snapshots
+	Measurement work;
+	// Latest readings before baseline subtraction
+	std::vector<double> raw_spectrum;
+	std::shared_ptr<const Measurement> work_baseline;
+	int work_baseline_mode;
+	AveragingSettings work_averaging;
+	// Sliding window over the last history values of each bin, or exponential
+	RunningStats<HistorySample> stats;
+	ExponentialStats exp_stats;
+	// Powers of the current hop converted to linear
+	std::vector<double> hop_power;
+	TripleBuffer<Measurement> snapshots;
+	// Of the newest hop accumulated since the last publish, worker owned
+	std::chrono::steady_clock::time_point newest_read;
+	std::chrono::steady_clock::time_point newest_pop;
+	// Snapshot picked up by update and not drawn yet, GUI thread owned
+	std::chrono::steady_clock::time_point merged_time;
+	bool draw_pending;
+
+	void reset_averaging();
+	bool work_has_baseline();
+	// Calls f(a, b) for every run [a, b) of bins in [first, last) with averaged values
+	template<typename F>
+	void for_each_stats_run(size_t first, size_t last, F&& f);
+
+	// Changes requested by the GUI thread, picked up by the worker
+	// before handling new data. Protected by mtx.
+	std::mutex mtx;
+	bool pending_settings_changed;
+	Settings pending_settings;
+	bool pending_averaging_changed;
+	AveragingSettings pending_averaging;
+	bool pending_baseline_changed;
+	std::shared_ptr<const Measurement> pending_baseline;
+	int pending_baseline_mode;
+
 public:
 
 	int baseline_mode;
 
+	// Worker thread side, merges a hop into the accumulated measurement
+	void accumulate(const Scan& sc);
+	// Worker thread side, picks up the changes requested by the GUI thread
+	void apply_pending();
+	// Worker thread side, hands a copy of the accumulated measurement to update()
+	void publish();
+	// GUI thread side, fetches the latest accumulated measurement into current
 	void update();
+	// GUI thread side, call once current has been drawn
+	void mark_drawn();
+	// Time taken by every stage from the input to the screen
+	PipelineLatency latency;
 	std::atomic<bool> launch_queued = false;
 
 	Settings exposed;
+	// Ingest rtl_power_fftw's raw float output instead of text, applied on commit
+	bool binary_transfer;
+	// rtl_power_fftw -d values (indices or serials) separated by commas, the range is
+	// split evenly between them and they sweep in parallel. Empty uses the default device.
+	// Applied on commit.
+	char devices[128];
+	// Run rtl_power_fftw or capture in process, applied on commit
+	SourceKind source_kind;
+	// Run instead of rtl_power_fftw, applied on commit
+	char power_command[256];
+	// Raw IQ file for the in-process engine instead of devices, applied on commit
+	char iq_file[256];
+	// Recording for the replay source, applied on commit
+	char replay_file[256];
+	// Comma separated MHz for the synthetic source, applied on commit
+	char tones[128];
+	// Of the replay and synthetic sources, 0 for as fast as possible. Applied on commit.
+	float hop_rate;
+	// Instead of sweeping continuously, do a full sweep and then adaptive_revisits
+	// sweeps of only the segments (hops) with the most activity. Applied on commit.
+	bool adaptive_sweep;
+	int adaptive_revisits;
+	// Segments revisited in the current cycle, over all devices
+	std::atomic<size_t> busy_segments;
 
 	void commit_settings();
+	// Call after changing averaging
 	void update_averaging();
 
 	bool can_change_settings();
 
 	void launch();
-	// Updates dynamic graphs
-	//void update(float dt);
 	
 	void stop();
 
 	// Returns Hertz / dB/Hz
+	// Snapshot of the worker's measurement, only touch from the GUI thread
 	Measurement current;
-	int num_average_hold;
+	// Increases whenever current changes, increase it too if you modify current
+	uint64_t current_version;
+	AveragingSettings averaging;
 	// Number of measurements since last update_averaging
-	// growing until it's equal to num_average_hold
-	int measurement_count;
-	std::vector<std::vector<double>> prev_measurements;
+	// growing until it's equal to averaging.history
+	std::atomic<int> measurement_count;
+	// Bytes used by the averaging history
+	std::atomic<size_t> history_memory;
+
+	// Appended by the worker with every completed sweep
+	Waterfall waterfall;
 
 	std::vector<Measurement> measures;
 	// Settings must match current, otherwise it's ignored
+	// Change it through set_baseline so the worker gets it too
 	std::optional<Measurement> baseline;
+	void set_baseline(const std::optional<Measurement>& nbaseline);
 
 	bool has_baseline();
 
-	bool get_power_status() { return power_wrapper.get_exec_status(); }
+	// Over all devices in use
+	size_t get_num_devices() { return num_devices; }
+	bool get_power_status();
+	double get_pipe_bytes_per_second();
+	double get_pipe_lines_per_second();
+	uint64_t get_hops_received();
+	uint64_t get_hops_dropped();
+	size_t get_hops_queued();
+	size_t get_hops_high_water();
+	size_t get_hops_capacity();
+	uint64_t get_allocations();
 
 	PlotBuilder();
 	~PlotBuilder();
 
 };
+
+// Calls f(SpectrumSource&) for every source in use, from threads other than the worker
+template<typename F>
+void PlotBuilder::for_each_source(F&& f)
+{
+	std::lock_guard<std::mutex> lock(wrapper_mtx);
+	for(size_t dev = 0; dev < num_devices; dev++)
+	{
+		if(sources[dev])
+		{
+			f(*sources[dev]);
+		}
+	}
+}
+
+template<typename F>
+void PlotBuilder::for_each_stats_run(size_t first, size_t last, F&& f)
+{
+	bool exponential = work_averaging.mode == 1;
+	size_t bin = first;
+	while(bin < last)
+	{
+		while(bin < last && !(exponential ? exp_stats.has_value(bin) : stats.count(bin) != 0))
+		{
+			bin++;
+		}
+		size_t start = bin;
+		while(bin < last && (exponential ? exp_stats.has_value(bin) : stats.count(bin) != 0))
+		{
+			bin++;
+		}
+		if(start < bin)
+		{
+			f(start, bin);
+		}
+	}
+}
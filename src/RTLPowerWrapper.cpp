@@ -5,9 +5,33 @@
 #include <sstream>
 #include <signal.h>
 #include <poll.h>
-#include <cassert>
 #include <iostream>
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <cmath>
+
+std::string RTLPowerWrapper::build_command()
+{
+	const RTLPowerConfig& cfg = running;
+	std::stringstream cmdbuild;
+	cmdbuild << cfg.command;
+	cmdbuild <<
+	" -b " << cfg.nbins <<
+	" -f " << cfg.min_f << ":" << cfg.max_f <<
+	" -g " << cfg.gain <<
+	" -o " << cfg.overlap_percent;
+	if(cfg.continuous)
+		cmdbuild << " -c";
+	if(cfg.use_stime)
+		cmdbuild << " -t " << cfg.stime;
+	else
+		cmdbuild << " -n " << cfg.snum;
+	if(!cfg.device.empty())
+		cmdbuild << " -d " << cfg.device;
+	if(cfg.binary)
+		cmdbuild << " -r " << cfg.samp_rate << " -m " << matrix_basename;
+	return cmdbuild.str();
+}
 
 void RTLPowerWrapper::launch()
 {
@@ -17,18 +41,26 @@ void RTLPowerWrapper::launch()
 		thread.join();
 	}
 
-	std::stringstream cmdbuild;
-	cmdbuild << "rtl_power_fftw";
-	cmdbuild <<
-	" -b " << nbins <<
-	" -f " << min_f << ":" << max_f <<
-	" -g " << gain <<
-	" -o " << overlap_percent <<
-	" -c";
-	if(use_stime)
-		cmdbuild << " -t " << stime;
-	else
-		cmdbuild << " -n " << snum;
+	running = next;
+	stop_requested = false;
+
+	int readfd = -1;
+	if(running.binary)
+	{
+		// rtl_power_fftw writes the matrix to basename.bin, which we make a FIFO
+		// so that it never touches the disk. Frequencies are not included in that
+		// output so we must make sure the sample rate is the one we assume.
+		matrix_basename = "/tmp/rtlpowergui-" + std::to_string(getpid()) + "-" + std::to_string(instance);
+		std::string fifo = matrix_basename + ".bin";
+		unlink(fifo.c_str());
+		if(mkfifo(fifo.c_str(), 0600) == -1)
+		{
+			std::cerr << "Unable to create FIFO " << fifo << std::endl;
+		}
+		// Opening non-blocking doesn't wait for the writer to appear
+		readfd = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+	}
+	std::string cmd = build_command();
 
 	// Launch the program
 	// [0] = read, [1] = write
@@ -42,162 +74,214 @@ void RTLPowerWrapper::launch()
 	{
 		// Child process
 		close(pipefd[0]);
-		dup2(pipefd[1], 1); // redirect stdout (fd 1) to pipe, this replaces the fd
+		if(running.binary)
+		{
+			// Text output is not used, but must not block the child either
+			int devnull = open("/dev/null", O_WRONLY);
+			dup2(devnull, 1);
+			close(devnull);
+		}
+		else
+		{
+			dup2(pipefd[1], 1); // redirect stdout (fd 1) to pipe, this replaces the fd
+		}
 		close(2); // close stderr
 		close(pipefd[1]); 	// so we dont need the pipe itself, as it's stdout itself now
 		// Launch the process replacing ourselves
-		execl("/bin/sh", "sh", "-c", cmdbuild.str().c_str(), nullptr);
+		execl("/bin/sh", "sh", "-c", cmd.c_str(), nullptr);
 	}
 	else
 	{
 		close(pipefd[1]);
+		if(running.binary)
+		{
+			close(pipefd[0]);
+		}
+		else
+		{
+			readfd = pipefd[0];
+		}
 	}
 
+	// Leftovers of a stopped run
+	back_buffer.reads.clear();
+	back_buffer.is_end_of_sweep = false;
+	skipped_prev = false;
+
+	reserve_hops();
+
 	thread_run = true;
 
 	// Launch worker thread
 	thread = std::thread([this](int readfd)
 	{
-		std::string readbuffer;
-		char inbuffer[128];
-
-		// Setup poll
-		struct pollfd pfd =
+		reader.reset();
+		if(running.binary)
 		{
-			readfd, POLLIN
-		};
-
-		while(thread_run)
+			read_binary(readfd);
+		}
+		else
 		{
-			poll(&pfd, 1, 100);
-			if(pfd.revents & POLLIN)
-			{
-				// Read as much as we can
-				size_t nread = read(pfd.fd, inbuffer, sizeof(inbuffer));
-				for(size_t i = 0; i < nread; i++)
-				{
-					readbuffer.push_back(inbuffer[i]);
-					if(inbuffer[i] == '\n')
-					{
-						process_line(readbuffer);
-						readbuffer.clear();
-					}
-				}
-			}
+			read_text(readfd);
 		}
-
 		close(readfd);
-	}, pipefd[0]);
+
+		// The process is gone (or we were stopped), let the consumer know
+		thread_run = false;
+		data_notify->notify_one();
+	}, readfd);
 
 
 }
 
-void RTLPowerWrapper::stop()
+void RTLPowerWrapper::read_text(int readfd)
 {
-	if(cur_pid != 0)
+	// Setup poll
+	pollfd pfd{};
+	pfd.fd = readfd;
+	pfd.events = POLLIN;
+
+	while(thread_run)
 	{
-		// TODO: Use SIGINT to smoothly shut off!
-		kill(cur_pid, SIGTERM);
-		kill(cur_pid, SIGTERM);
-		wait(nullptr);
+		poll(&pfd, 1, 100);
+		if(pfd.revents & (POLLIN | POLLHUP))
+		{
+			text_read_time = std::chrono::steady_clock::now();
+			// Read as much as we can, lines are handed over without copying
+			ssize_t nread = reader.read_from(pfd.fd, [this](std::string_view line)
+			{
+				process_text_line(line);
+			});
+			if(nread == 0)
+			{
+				// rtl_power_fftw closed its end
+				end_text();
+				break;
+			}
+		}
+		else
+		{
+			reader.rates.tick();
+		}
 	}
-	thread_run = false;
 }
 
-void RTLPowerWrapper::set_freq_range(uint64_t min, uint64_t max)
+void RTLPowerWrapper::read_binary(int readfd)
 {
-	assert(!thread_run);
-	min_f = min;
-	max_f = max;
-}
+	// Each row of the matrix is a whole sweep of float32 powers, with the same layout
+	// as the .bin files read by Measurement::from_binFile_raw: every hop's bins in turn
+	double hertz_per_bin = running.get_hertz_per_bin();
+	size_t nbins = running.nbins;
+	size_t row_bins = get_matrix_columns();
+	std::vector<float> row(row_bins);
+	size_t row_bytes = row_bins * sizeof(float);
+	size_t filled = 0;
 
-void RTLPowerWrapper::set_num_bins(int bins)
-{
-	assert(!thread_run);
-	nbins = bins;
-}
+	pollfd pfd{};
+	pfd.fd = readfd;
+	pfd.events = POLLIN;
 
-void RTLPowerWrapper::set_overlap(int percent)
-{
-	assert(!thread_run);
-	overlap_percent = percent;
-}
+	while(thread_run)
+	{
+		poll(&pfd, 1, 100);
+		if(!(pfd.revents & (POLLIN | POLLHUP)))
+		{
+			reader.rates.tick();
+			continue;
+		}
 
-void RTLPowerWrapper::set_num_samples(int nsamples)
-{
-	assert(!thread_run);
-	snum = nsamples;
-	use_stime = false;
-}
+		ssize_t nread = read(pfd.fd, (char*)row.data() + filled, row_bytes - filled);
+		if(nread == 0)
+		{
+			break;
+		}
+		else if(nread < 0)
+		{
+			continue;
+		}
 
-double RTLPowerWrapper::set_samp_time(double nstime)
-{
-	assert(!thread_run);
-	stime = nstime;
-	use_stime = true;
-	return 0;
+		if(filled == 0)
+		{
+			back_buffer.read_time = std::chrono::steady_clock::now();
+		}
+		filled += nread;
+		if(filled == row_bytes)
+		{
+			reserve_reads(back_buffer.reads, row_bins);
+			back_buffer.reads.resize(row_bins);
+			for(size_t i = 0; i < row_bins; i++)
+			{
+				double hop_low = running.get_hop_center(i / nbins) - running.samp_rate / 2.0;
+				back_buffer.reads[i].freq = hop_low + (i % nbins) * hertz_per_bin;
+				back_buffer.reads[i].power = row[i];
+			}
+			back_buffer.is_end_of_sweep = true;
+			publish_back_buffer();
+			filled = 0;
+		}
+		reader.rates.update(nread, filled == 0 ? row_bins : 0);
+	}
 }
 
-void RTLPowerWrapper::set_gain(int ngain)
+void RTLPowerWrapper::request_stop()
 {
-	assert(!thread_run);
-	gain = ngain;
+	if(cur_pid != 0 && !stop_requested)
+	{
+		// TODO: Use SIGINT to smoothly shut off!
+		kill(cur_pid, SIGTERM);
+		stop_requested = true;
+		stop_time = std::chrono::steady_clock::now();
+	}
+	thread_run = false;
+
+	if(!matrix_basename.empty())
+	{
+		unlink((matrix_basename + ".bin").c_str());
+		unlink((matrix_basename + ".met").c_str());
+		matrix_basename.clear();
+	}
 }
 
-void RTLPowerWrapper::process_line(const std::string &line)
+bool RTLPowerWrapper::reap()
 {
-	if(line[0] == '#')
+	if(cur_pid == 0)
 	{
-		return;
+		return true;
 	}
 
-	if(line == "\n")
+	// Only our own child, others may belong to other wrappers
+	if(waitpid(cur_pid, nullptr, WNOHANG) == cur_pid)
 	{
-		if(skipped_prev)
-		{
-			// End of sweep, notify with flag, and do nothing else
-			back_buffer.is_end_of_sweep = true;
-		}
-		skipped_prev = true;
+		cur_pid = 0;
+		return true;
 	}
-	else
-	{
-		if(skipped_prev)
-		{
-			// A spectrum was obtained last call,
-			// Put back buffer back to front and notify
-			data_mtx.lock();
-			front_buffer = back_buffer;
-			data = &front_buffer;
-			data_mtx.unlock();
-			data_available.notify_one();
-
-			// Clear back buffer
-			back_buffer = RTLPowerData();
-			back_buffer.is_end_of_sweep = false;
-			skipped_prev = false;
-		}
 
-		// Format is frequency [Hz] as scientific notation number
-		// followed by a space and then spectral density dB/Hz (arbitrarily referenced)
-		Readout read{};
-		std::stringstream s(line);
-		s >> read.freq >> read.power;
-		back_buffer.reads.push_back(read);
+	if(stop_requested && std::chrono::steady_clock::now() - stop_time > kill_timeout)
+	{
+		kill(cur_pid, SIGKILL);
 	}
+	return false;
 }
 
-bool RTLPowerWrapper::is_stopped()
+size_t RTLPowerWrapper::get_matrix_columns()
 {
-	return !thread_run;
+	// rtl_power_fftw writes whole hops, the last one may go past max_f
+	return running.get_num_hops() * running.nbins;
+}
+
+size_t RTLPowerWrapper::get_hop_size()
+{
+	// A text hop is a single FFT, whereas a matrix row holds the whole sweep
+	return running.binary ? get_matrix_columns() : running.nbins;
 }
 
 RTLPowerWrapper::RTLPowerWrapper()
 {
-	thread_run = false;
 	cur_pid = 0;
-	skipped_prev = false;
-	data = nullptr;
+	stop_requested = false;
+
+	static std::atomic<int> instances(0);
+	instance = instances++;
 }
 
 RTLPowerWrapper::~RTLPowerWrapper()
@@ -214,6 +298,6 @@ RTLPowerWrapper::~RTLPowerWrapper()
 bool RTLPowerWrapper::get_exec_status()
 {
 	// -1 means it's not running
-	return kill(cur_pid, 0) == -1;
+	return cur_pid == 0 || kill(cur_pid, 0) == -1;
 }
 
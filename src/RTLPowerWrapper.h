@@ -1,76 +1,52 @@
 #pragma once
-#include <thread>
-#include <condition_variable>
-#include <atomic>
-#include <vector>
-
-struct Readout
-{
-	double freq;
-	double power;
-};
-
-struct RTLPowerData
-{
-	bool is_end_of_sweep;
-	std::vector<Readout> reads;
-};
+#include <string>
+#include <string_view>
+#include "PipeReader.h"
+#include "SpectrumSource.h"
 
 // To prevent needless overhead, we only re-launch the power software
 // when parameters (start and end frequency / bins) are changed.
 // So the whole thing runs in a thread and returns data back gradually to the rest of the software
-class RTLPowerWrapper
+class RTLPowerWrapper : public SpectrumSource
 {
 private:
 
-	// In Hertz
-	uint64_t min_f, max_f;
-	int nbins;
-	int overlap_percent;
+	std::string matrix_basename;
+	// Keeps FIFO names apart when several wrappers run at once
+	int instance;
 
-	bool use_stime;
-	double stime;
-	int gain;
-	int snum;
-
-	std::thread thread;
-
-	std::atomic<bool> thread_run;
 	std::atomic<int> cur_pid;
+	bool stop_requested;
+	std::chrono::steady_clock::time_point stop_time;
 
-	bool skipped_prev;
-	void process_line(const std::string& line);
+	PipeReader reader;
 
-public:
+	std::string build_command();
 
+	void read_text(int readfd);
+	void read_binary(int readfd);
 
-	// Will stop after next run is done
-	void stop();
+	size_t get_hop_size() override;
+	size_t get_matrix_columns();
+
+public:
 
-	// The following functions can only be called if stopped / stopping
-	void set_freq_range(uint64_t min, uint64_t max);
-	void set_num_bins(int nbins);
-	void set_overlap(int percent);
-	void set_num_samples(int nsamples);
-	double set_samp_time(double stime);
-	void set_gain(int ngain);
+	// If rtl_power_fftw ignores SIGTERM for this long, it's killed
+	static constexpr std::chrono::milliseconds kill_timeout{2000};
 
-	void launch();
-	bool is_stopped();
+	SourceKind get_kind() override { return SourceKind::rtl_power_fftw; }
 
-	bool get_exec_status();
+	void launch() override;
+	// Sends SIGTERM
+	void request_stop() override;
+	// Collects our own child (and kills it after kill_timeout)
+	bool reap() override;
 
-	// This cvar will be notified once data is available, use
-	// the data_mtx to lock it
-	std::condition_variable data_available;
-	std::mutex data_mtx;
+	bool get_exec_status() override;
 
-	// Set to point to data if new data is available (to prevent spurious wake up, use
-	// as predicate). Handle / copy data and set back to nullptr (do not free!)
-	RTLPowerData* data;
-	// Sample data is written here, copy it and continue operation on data available
-	RTLPowerData front_buffer;
-	RTLPowerData back_buffer;
+	// Throughput of the rtl_power_fftw pipe
+	double get_bytes_per_second() override { return reader.rates.bytes_per_second; }
+	double get_lines_per_second() override { return reader.rates.lines_per_second; }
 
 	RTLPowerWrapper();
 	~RTLPowerWrapper();
@@ -0,0 +1,416 @@
+#include "RTLSDREngine.h"
+#include "DspKernels.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#ifdef RTLPOWERGUI_HAVE_FFTW
+#include <fftw3.h>
+#endif
+#ifdef RTLPOWERGUI_HAVE_RTLSDR
+#include <rtl-sdr.h>
+#endif
+
+#ifdef RTLPOWERGUI_HAVE_FFTW
+// Planning is slow and not thread safe, so plans are made once per size and
+// shared by every engine. They're only executed on other, equally aligned, arrays.
+static fftwf_plan get_plan(int n)
+{
+	static std::mutex mtx;
+	static std::unordered_map<int, fftwf_plan> plans;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = plans.find(n);
+	if(it != plans.end())
+	{
+		return it->second;
+	}
+
+	AlignedBuffer<std::complex<float>> in, out;
+	in.resize(n);
+	out.resize(n);
+	fftwf_plan plan = fftwf_plan_dft_1d(n, (fftwf_complex*)in.data(), (fftwf_complex*)out.data(),
+										FFTW_FORWARD, FFTW_MEASURE);
+	plans[n] = plan;
+	return plan;
+}
+#endif
+
+void RTLSDREngine::launch()
+{
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+
+	running = next;
+	reserve_hops();
+	rates.reset();
+
+	finished = false;
+	thread_run = true;
+	thread = std::thread([this]()
+	{
+		run();
+	});
+}
+
+void RTLSDREngine::request_stop()
+{
+	thread_run = false;
+	blocks_available.notify_one();
+}
+
+bool RTLSDREngine::reap()
+{
+	if(!thread.joinable())
+	{
+		return true;
+	}
+	if(!finished)
+	{
+		return false;
+	}
+	thread.join();
+	return true;
+}
+
+void RTLSDREngine::run()
+{
+	if(open_input())
+	{
+		size_t n = running.nbins;
+		window.resize(n);
+		power.resize(n);
+		fft_in.resize(n);
+		fft_out.resize(n);
+		for(size_t i = 0; i < n; i++)
+		{
+			// Hann
+			window[i] = 0.5f - 0.5f * std::cos(2.0 * M_PI * i / n);
+		}
+
+		size_t nhops = running.get_num_hops();
+		do
+		{
+			for(size_t h = 0; h < nhops && thread_run; h++)
+			{
+				if(!measure_hop(running.get_hop_center(h)))
+				{
+					thread_run = false;
+					break;
+				}
+				back_buffer.is_end_of_sweep = h + 1 == nhops;
+				publish_back_buffer();
+			}
+		} while(thread_run && running.continuous);
+	}
+
+	close_input();
+	thread_run = false;
+	finished = true;
+	data_notify->notify_one();
+}
+
+bool RTLSDREngine::open_input()
+{
+#ifndef RTLPOWERGUI_HAVE_FFTW
+	std::cerr << "Built without FFTW, the in-process engine is not available" << std::endl;
+	return false;
+#else
+	plan = get_plan(running.nbins);
+
+	// Block storage circulates like hop storage does
+	capture_block.data.reserve(block_size);
+	work_block.data.clear();
+	blocks.for_each_slot([](IQBlock& block)
+	{
+		block.data.reserve(block_size);
+	});
+	block_pos = 0;
+	settle_left = 0;
+	tuned_center = 0;
+	capture_done = false;
+
+	if(!running.iq_file.empty())
+	{
+		file = std::fopen(running.iq_file.c_str(), "rb");
+		if(!file)
+		{
+			std::cerr << "Unable to open IQ file " << running.iq_file << std::endl;
+			return false;
+		}
+		capture_thread = std::thread([this]()
+		{
+			capture_file();
+		});
+	}
+	else
+	{
+#ifdef RTLPOWERGUI_HAVE_RTLSDR
+		int index = 0;
+		if(!running.device.empty())
+		{
+			bool is_index = std::all_of(running.device.begin(), running.device.end(), [](char c) { return std::isdigit((unsigned char)c); });
+			index = is_index ? std::stoi(running.device) : rtlsdr_get_index_by_serial(running.device.c_str());
+		}
+
+		rtlsdr_dev_t* dev = nullptr;
+		if(index < 0 || rtlsdr_open(&dev, index) != 0)
+		{
+			std::cerr << "Unable to open RTL-SDR device " << running.device << std::endl;
+			return false;
+		}
+		rtlsdr_set_sample_rate(dev, running.samp_rate);
+		rtlsdr_set_tuner_gain_mode(dev, 1);
+		rtlsdr_set_tuner_gain(dev, running.gain);
+		rtlsdr_reset_buffer(dev);
+		device = dev;
+
+		// Returns once cancelled by close_input
+		capture_thread = std::thread([this]()
+		{
+			rtlsdr_read_async((rtlsdr_dev_t*)device, on_samples, this, 0, block_size);
+		});
+#else
+		std::cerr << "Built without librtlsdr, only IQ files can be used" << std::endl;
+		return false;
+#endif
+	}
+
+	input_open = true;
+	return true;
+#endif
+}
+
+void RTLSDREngine::close_input()
+{
+#ifdef RTLPOWERGUI_HAVE_RTLSDR
+	if(device)
+	{
+		rtlsdr_cancel_async((rtlsdr_dev_t*)device);
+	}
+#endif
+	if(capture_thread.joinable())
+	{
+		capture_thread.join();
+	}
+#ifdef RTLPOWERGUI_HAVE_RTLSDR
+	if(device)
+	{
+		rtlsdr_close((rtlsdr_dev_t*)device);
+		device = nullptr;
+	}
+#endif
+	if(file)
+	{
+		std::fclose(file);
+		file = nullptr;
+	}
+
+	while(blocks.pop_swap(work_block)) {}
+	input_open = false;
+}
+
+void RTLSDREngine::on_samples(unsigned char* buf, uint32_t len, void* ctx)
+{
+	RTLSDREngine* engine = (RTLSDREngine*)ctx;
+	engine->capture_block.data.assign(buf, buf + len);
+	engine->capture_block.tuning = engine->tuning;
+	engine->capture_block.time = std::chrono::steady_clock::now();
+	// Real time, if the worker falls behind the block is lost
+	engine->push_block(false);
+}
+
+void RTLSDREngine::capture_file()
+{
+	bool any = false;
+	while(thread_run)
+	{
+		capture_block.data.resize(block_size);
+		size_t n = std::fread(capture_block.data.data(), 1, block_size, file);
+		capture_block.data.resize(n);
+		if(n > 0)
+		{
+			any = true;
+			capture_block.tuning = tuning;
+			capture_block.time = std::chrono::steady_clock::now();
+			// Files can wait for the worker instead
+			push_block(true);
+		}
+
+		if(n < block_size)
+		{
+			// Rewinding an empty file would spin forever
+			if(!running.continuous || !any || std::ferror(file))
+			{
+				break;
+			}
+			std::rewind(file);
+		}
+	}
+
+	capture_done = true;
+	blocks_available.notify_one();
+}
+
+bool RTLSDREngine::push_block(bool wait)
+{
+	while(wait && thread_run && blocks.full())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if(!blocks.push_swap(capture_block))
+	{
+		return false;
+	}
+	blocks_available.notify_one();
+	return true;
+}
+
+void RTLSDREngine::retune(uint64_t center)
+{
+#ifdef RTLPOWERGUI_HAVE_RTLSDR
+	if(device && center != tuned_center)
+	{
+		rtlsdr_set_center_freq((rtlsdr_dev_t*)device, center);
+		tuned_center = center;
+		tuning++;
+		settle_left = settle_blocks;
+		block_pos = work_block.data.size();
+	}
+#else
+	(void)center;
+#endif
+}
+
+bool RTLSDREngine::read_samples(size_t n)
+{
+	size_t i = 0;
+	while(i < n)
+	{
+		if(block_pos + 2 > work_block.data.size())
+		{
+			if(!blocks.pop_swap(work_block))
+			{
+				if(!thread_run || (capture_done && blocks.empty()))
+				{
+					return false;
+				}
+				rates.tick();
+				std::unique_lock<std::mutex> lock(blocks_mtx);
+				blocks_available.wait_for(lock, std::chrono::milliseconds(10), [this]() { return !blocks.empty(); });
+				continue;
+			}
+
+			block_pos = 0;
+			rates.update(work_block.data.size(), 0);
+			// Samples from before the last retune, or right after it, are useless
+			if(work_block.tuning != tuning || settle_left > 0)
+			{
+				if(work_block.tuning == tuning)
+				{
+					settle_left--;
+				}
+				block_pos = work_block.data.size();
+				continue;
+			}
+		}
+
+		// The hop is as old as its oldest samples
+		if(back_buffer.read_time == std::chrono::steady_clock::time_point())
+		{
+			back_buffer.read_time = work_block.time;
+		}
+		const uint8_t* iq = work_block.data.data() + block_pos;
+		size_t take = std::min(n - i, (work_block.data.size() - block_pos) / 2);
+		for(size_t j = 0; j < take; j++)
+		{
+			float re = (iq[2 * j] - 127.5f) / 127.5f;
+			float im = (iq[2 * j + 1] - 127.5f) / 127.5f;
+			fft_in[i + j] = std::complex<float>(re, im) * window[i + j];
+		}
+		i += take;
+		block_pos += 2 * take;
+	}
+	return true;
+}
+
+bool RTLSDREngine::measure_hop(uint64_t center)
+{
+	retune(center);
+
+	size_t n = running.nbins;
+	int navg = std::max(running.snum, 1);
+	if(running.use_stime)
+	{
+		navg = std::max((int)std::ceil(running.stime * running.samp_rate / n), 1);
+	}
+
+	std::fill(power.begin(), power.end(), 0.0);
+	for(int s = 0; s < navg; s++)
+	{
+		if(!read_samples(n))
+		{
+			return false;
+		}
+#ifdef RTLPOWERGUI_HAVE_FFTW
+		fftwf_execute_dft((fftwf_plan)plan, (fftwf_complex*)fft_in.data(), (fftwf_complex*)fft_out.data());
+#endif
+		for(size_t k = 0; k < n; k++)
+		{
+			power[k] += std::norm(fft_out[k]);
+		}
+	}
+
+	// Normalized so white noise reads the same whatever nbins and the window
+	double window_power = 0.0;
+	for(float w : window)
+	{
+		window_power += w * w;
+	}
+	double scale = 1.0 / (navg * window_power);
+
+	// FFT output starts at the center, readouts at the bottom of the hop
+	std::rotate(power.begin(), power.begin() + n / 2, power.end());
+	dsp::scale(power.data(), scale, n);
+	dsp::linear_to_db(power.data(), power.data(), n);
+
+	double hertz_per_bin = running.get_hertz_per_bin();
+	double low = (double)center - running.samp_rate / 2.0;
+	reserve_reads(back_buffer.reads, n);
+	back_buffer.reads.resize(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		back_buffer.reads[i].freq = low + i * hertz_per_bin;
+		back_buffer.reads[i].power = power[i];
+	}
+	rates.update(0, n);
+	return true;
+}
+
+RTLSDREngine::RTLSDREngine() : blocks(64)
+{
+	tuning = 0;
+	capture_done = false;
+	device = nullptr;
+	file = nullptr;
+	block_pos = 0;
+	settle_left = 0;
+	tuned_center = 0;
+	plan = nullptr;
+	input_open = false;
+	finished = true;
+}
+
+RTLSDREngine::~RTLSDREngine()
+{
+	stop();
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <complex>
+#include <cstdio>
+#include "SpectrumSource.h"
+#include "AlignedBuffer.h"
+#include "RateMeter.h"
+
+// Captures IQ with librtlsdr (or reads it from a file) and computes the spectra
+// in this process with FFTW, so there's no child process, pipe or text involved.
+// Hops are laid out like rtl_power_fftw's: each one spans samp_rate, starting at
+// min_f, and consecutive ones overlap by overlap_percent.
+// The device path needs RTLPOWERGUI_HAVE_RTLSDR, the whole engine RTLPOWERGUI_HAVE_FFTW.
+class RTLSDREngine : public SpectrumSource
+{
+private:
+
+	// Raw unsigned 8 bit IQ pairs, tagged with the tuning and time they were captured at
+	struct IQBlock
+	{
+		std::vector<uint8_t> data;
+		uint64_t tuning = 0;
+		std::chrono::steady_clock::time_point time;
+	};
+	static constexpr size_t block_size = 1 << 16;
+	// Blocks delivered right after retuning may still hold the old frequency
+	static constexpr int settle_blocks = 2;
+
+	// Capture side, librtlsdr's callback or the file reader
+	std::thread capture_thread;
+	IQBlock capture_block;
+	std::atomic<uint64_t> tuning;
+	uint64_t tuned_center;
+	// The file ended and won't be rewound
+	std::atomic<bool> capture_done;
+	void* device;
+	FILE* file;
+	static void on_samples(unsigned char* buf, uint32_t len, void* ctx);
+	void capture_file();
+	bool push_block(bool wait);
+
+	SpscRing<IQBlock> blocks;
+	std::condition_variable blocks_available;
+	std::mutex blocks_mtx;
+
+	// Worker side
+	IQBlock work_block;
+	size_t block_pos;
+	int settle_left;
+	std::vector<float> window;
+	std::vector<double> power;
+	AlignedBuffer<std::complex<float>> fft_in;
+	AlignedBuffer<std::complex<float>> fft_out;
+	void* plan;
+
+	std::atomic<bool> input_open;
+	// The worker thread ended and can be joined
+	std::atomic<bool> finished;
+	RateMeter rates;
+
+	void run();
+	bool open_input();
+	void close_input();
+	void retune(uint64_t center);
+	// Fills fft_in with the next n samples, windowed. False once the input ended.
+	bool read_samples(size_t n);
+	// Averages the power spectra of snum FFTs centered at center into back_buffer
+	bool measure_hop(uint64_t center);
+
+public:
+
+	SourceKind get_kind() override { return SourceKind::direct; }
+
+	void launch() override;
+	void request_stop() override;
+	bool reap() override;
+
+	bool get_exec_status() override { return !input_open; }
+
+	// IQ bytes consumed and readouts produced
+	double get_bytes_per_second() override { return rates.bytes_per_second; }
+	double get_lines_per_second() override { return rates.lines_per_second; }
+
+	RTLSDREngine();
+	~RTLSDREngine();
+};
@@ -0,0 +1,36 @@
+#include "RateMeter.h"
+
+void RateMeter::update(size_t nbytes, size_t nlines)
+{
+	total_bytes += nbytes;
+	total_lines += nlines;
+	rate_bytes += nbytes;
+	rate_lines += nlines;
+
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - rate_start).count();
+	if(elapsed >= 1.0)
+	{
+		bytes_per_second = rate_bytes / elapsed;
+		lines_per_second = rate_lines / elapsed;
+		rate_bytes = 0;
+		rate_lines = 0;
+		rate_start = now;
+	}
+}
+
+void RateMeter::reset()
+{
+	rate_bytes = 0;
+	rate_lines = 0;
+	rate_start = std::chrono::steady_clock::now();
+	total_bytes = 0;
+	total_lines = 0;
+	bytes_per_second = 0.0;
+	lines_per_second = 0.0;
+}
+
+RateMeter::RateMeter()
+{
+	reset();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Throughput of some input in bytes and lines (or readouts), written by one
+// thread and readable from any
+class RateMeter
+{
+private:
+	std::chrono::steady_clock::time_point rate_start;
+	uint64_t rate_bytes;
+	uint64_t rate_lines;
+
+public:
+	std::atomic<uint64_t> total_bytes;
+	std::atomic<uint64_t> total_lines;
+	// Updated roughly once per second
+	std::atomic<double> bytes_per_second;
+	std::atomic<double> lines_per_second;
+
+	void update(size_t nbytes, size_t nlines);
+	// Call when nothing was read for a while so rates decay to zero
+	void tick() { update(0, 0); }
+	void reset();
+
+	RateMeter();
+};
@@ -0,0 +1,28 @@
+#include "ReadoutParser.h"
+#include <charconv>
+
+static const char* skip_blanks(const char* it, const char* end)
+{
+	while(it != end && (*it == ' ' || *it == '\t'))
+	{
+		it++;
+	}
+	return it;
+}
+
+bool parse_readout(std::string_view line, Readout& out)
+{
+	const char* it = line.data();
+	const char* end = line.data() + line.size();
+
+	it = skip_blanks(it, end);
+	auto [fend, ferr] = std::from_chars(it, end, out.freq);
+	if(ferr != std::errc())
+	{
+		return false;
+	}
+
+	it = skip_blanks(fend, end);
+	auto [pend, perr] = std::from_chars(it, end, out.power);
+	return perr == std::errc();
+}
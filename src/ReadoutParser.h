@@ -0,0 +1,14 @@
+#pragma once
+#include <string_view>
+
+struct Readout
+{
+	double freq;
+	double power;
+};
+
+// Parses a "frequency power" line as written by rtl_power_fftw (frequency in Hz,
+// usually in scientific notation, then the power in dB). Doesn't allocate nor touch
+// the locale, as it runs for every single bin.
+// Returns false if the line doesn't contain two numbers.
+bool parse_readout(std::string_view line, Readout& out);
@@ -0,0 +1,208 @@
+#include "ReplaySource.h"
+#include "PlotBuilder.h"
+#include <fcntl.h>
+#include <iostream>
+
+static bool ends_with(const std::string& str, const std::string& suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void ReplaySource::launch()
+{
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+
+	running = next;
+	matrix_basename.clear();
+	matrix_columns = 0;
+	if(ends_with(running.replay_file, ".bin") || ends_with(running.replay_file, ".met"))
+	{
+		// Rows hold no frequencies, those come from the metadata
+		Measurement meta;
+		try
+		{
+			matrix_basename = running.replay_file.substr(0, running.replay_file.size() - 4);
+			Measurement::from_binFile_meta(matrix_basename + ".met", meta);
+			matrix_columns = meta.settings.nbins;
+			matrix_low = meta.settings.min_freq;
+			matrix_step = meta.stepFreq;
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			matrix_columns = 0;
+		}
+	}
+
+	back_buffer.reads.clear();
+	back_buffer.is_end_of_sweep = false;
+	skipped_prev = false;
+	reserve_hops();
+	reader.reset();
+
+	finished = false;
+	thread_run = true;
+	thread = std::thread([this]()
+	{
+		run();
+	});
+}
+
+void ReplaySource::request_stop()
+{
+	thread_run = false;
+}
+
+bool ReplaySource::reap()
+{
+	if(!thread.joinable())
+	{
+		return true;
+	}
+	if(!finished)
+	{
+		return false;
+	}
+	thread.join();
+	return true;
+}
+
+void ReplaySource::run()
+{
+	std::string fname = matrix_basename.empty() ? running.replay_file : matrix_basename + ".bin";
+	int fd = open(fname.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		std::cerr << "Unable to open replay file " << fname << std::endl;
+	}
+	else if(!matrix_basename.empty())
+	{
+		if(matrix_columns > 0)
+		{
+			replay_binary(fd);
+		}
+		close(fd);
+	}
+	else
+	{
+		replay_text(fd);
+		close(fd);
+	}
+
+	thread_run = false;
+	finished = true;
+	data_notify->notify_one();
+}
+
+void ReplaySource::replay_text(int fd)
+{
+	pace_start();
+	bool any = false;
+	while(thread_run)
+	{
+		text_read_time = std::chrono::steady_clock::now();
+		ssize_t nread = reader.read_from(fd, [this](std::string_view line)
+		{
+			process_text_line(line);
+		});
+		if(nread > 0)
+		{
+			any = true;
+			continue;
+		}
+
+		end_text();
+		// Rewinding an empty file would spin forever
+		if(nread < 0 || !running.continuous || !any)
+		{
+			break;
+		}
+		lseek(fd, 0, SEEK_SET);
+	}
+}
+
+void ReplaySource::replay_binary(int fd)
+{
+	// Same layout as rtl_power_fftw's matrix output, see RTLPowerWrapper::read_binary
+	std::vector<float> row(matrix_columns);
+	size_t row_bytes = matrix_columns * sizeof(float);
+	size_t filled = 0;
+	bool any = false;
+
+	pace_start();
+	while(thread_run)
+	{
+		ssize_t nread = read(fd, (char*)row.data() + filled, row_bytes - filled);
+		if(nread <= 0)
+		{
+			// A partial row at the end is dropped
+			if(nread < 0 || !running.continuous || !any)
+			{
+				break;
+			}
+			lseek(fd, 0, SEEK_SET);
+			filled = 0;
+			continue;
+		}
+
+		if(filled == 0)
+		{
+			back_buffer.read_time = std::chrono::steady_clock::now();
+		}
+		filled += nread;
+		if(filled == row_bytes)
+		{
+			any = true;
+			reserve_reads(back_buffer.reads, matrix_columns);
+			back_buffer.reads.resize(matrix_columns);
+			for(size_t i = 0; i < matrix_columns; i++)
+			{
+				back_buffer.reads[i].freq = matrix_low + i * matrix_step;
+				back_buffer.reads[i].power = row[i];
+			}
+			back_buffer.is_end_of_sweep = true;
+			publish_back_buffer();
+			filled = 0;
+		}
+		reader.rates.update(nread, filled == 0 ? matrix_columns : 0);
+	}
+}
+
+void ReplaySource::publish_back_buffer()
+{
+	pace(running.hop_rate);
+	// Paced hops arrive when they're due, not when the file was read
+	if(running.hop_rate > 0.0)
+	{
+		back_buffer.read_time = std::chrono::steady_clock::now();
+	}
+	push_back_buffer(true);
+}
+
+size_t ReplaySource::get_hop_size()
+{
+	// A matrix row holds the whole sweep
+	return matrix_columns > 0 ? matrix_columns : running.nbins;
+}
+
+ReplaySource::ReplaySource()
+{
+	matrix_columns = 0;
+	matrix_low = 0.0;
+	matrix_step = 0.0;
+	finished = true;
+}
+
+ReplaySource::~ReplaySource()
+{
+	stop();
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "SpectrumSource.h"
+#include "PipeReader.h"
+
+// Plays back a recording instead of running anything, to exercise the whole
+// pipeline without hardware. Takes rtl_power_fftw's text output, or the .bin/.met
+// pair written with -m (either file name works). Continuous runs loop the file.
+// Hops wait for the consumer instead of being dropped, and can be paced with
+// hop_rate, so runs are reproducible.
+// The recording is replayed as is: commit a range and bin count matching it.
+class ReplaySource : public SpectrumSource
+{
+private:
+
+	PipeReader reader;
+	// Of the .bin/.met pair, empty when replaying text
+	std::string matrix_basename;
+	size_t matrix_columns;
+	double matrix_low;
+	double matrix_step;
+
+	// The worker thread ended and can be joined
+	std::atomic<bool> finished;
+
+	void run();
+	void replay_text(int fd);
+	void replay_binary(int fd);
+
+	void publish_back_buffer() override;
+	size_t get_hop_size() override;
+
+public:
+
+	SourceKind get_kind() override { return SourceKind::replay; }
+
+	void launch() override;
+	void request_stop() override;
+	bool reap() override;
+
+	bool get_exec_status() override { return !thread_run; }
+
+	// Throughput of reading the recording
+	double get_bytes_per_second() override { return reader.rates.bytes_per_second; }
+	double get_lines_per_second() override { return reader.rates.lines_per_second; }
+
+	ReplaySource();
+	~ReplaySource();
+};
@@ -0,0 +1,152 @@
+#include "RunningStats.h"
+#include <cmath>
+
+template<typename Sample>
+void RunningStats<Sample>::resize(size_t nbins, size_t nhistory)
+{
+	bins = nbins;
+	history = nhistory;
+
+	slot_bytes = history <= 256 ? 1 : (history <= 65536 ? 2 : 4);
+	size_t bytes = history * (sizeof(Sample) + 2 * slot_bytes);
+	tile_size = (bytes + sizeof(Sample) - 1) / sizeof(Sample) * sizeof(Sample);
+	arena.resize(bins * tile_size);
+	arena.fill_zero();
+
+	sum.assign(bins, 0.0);
+	pos.assign(bins, 0);
+	filled.assign(bins, 0);
+	max_head.assign(bins, 0);
+	max_len.assign(bins, 0);
+	min_head.assign(bins, 0);
+	min_len.assign(bins, 0);
+}
+
+template<typename Sample>
+void RunningStats<Sample>::recompute_sum(size_t bin)
+{
+	// Removes the floating point drift of adding and subtracting forever
+	const Sample* values = values_of(bin);
+	double s = 0.0;
+	for(uint32_t i = 0; i < filled[bin]; i++)
+	{
+		s += values[i];
+	}
+	sum[bin] = s;
+}
+
+template<typename Sample>
+void RunningStats<Sample>::push(size_t bin, double value)
+{
+	Sample* values = values_of(bin);
+	unsigned char* max_dq = max_dq_of(bin);
+	unsigned char* min_dq = min_dq_of(bin);
+	uint32_t slot = pos[bin];
+
+	if(filled[bin] == history)
+	{
+		// The value in this slot leaves the window
+		sum[bin] -= values[slot];
+		if(get_slot(max_dq, max_head[bin]) == slot)
+		{
+			max_head[bin] = wrap(max_head[bin] + 1);
+			max_len[bin]--;
+		}
+		if(get_slot(min_dq, min_head[bin]) == slot)
+		{
+			min_head[bin] = wrap(min_head[bin] + 1);
+			min_len[bin]--;
+		}
+	}
+	else
+	{
+		filled[bin]++;
+	}
+
+	Sample v = (Sample)value;
+	values[slot] = v;
+	sum[bin] += v;
+
+	// Values dominated by the new one can never be the maximum (minimum) again
+	while(max_len[bin] != 0 && values[get_slot(max_dq, wrap(max_head[bin] + max_len[bin] - 1))] <= v)
+	{
+		max_len[bin]--;
+	}
+	set_slot(max_dq, wrap(max_head[bin] + max_len[bin]), slot);
+	max_len[bin]++;
+
+	while(min_len[bin] != 0 && values[get_slot(min_dq, wrap(min_head[bin] + min_len[bin] - 1))] >= v)
+	{
+		min_len[bin]--;
+	}
+	set_slot(min_dq, wrap(min_head[bin] + min_len[bin]), slot);
+	min_len[bin]++;
+
+	pos[bin] = wrap(slot + 1);
+	if(pos[bin] == 0)
+	{
+		recompute_sum(bin);
+	}
+}
+
+template<typename Sample>
+void RunningStats<Sample>::get_range(size_t first, size_t last, double* avg, double* max, double* min) const
+{
+	for(size_t bin = first; bin < last; bin++)
+	{
+		if(filled[bin] == 0)
+		{
+			continue;
+		}
+		const Sample* values = values_of(bin);
+		avg[bin - first] = sum[bin] / filled[bin];
+		max[bin - first] = values[get_slot(max_dq_of(bin), max_head[bin])];
+		min[bin - first] = values[get_slot(min_dq_of(bin), min_head[bin])];
+	}
+}
+
+template<typename Sample>
+RunningStats<Sample>::RunningStats()
+{
+	bins = 0;
+	history = 0;
+	slot_bytes = 4;
+	tile_size = 0;
+}
+
+void ExponentialStats::resize(size_t nbins, double time_constant, double ndecay, bool nlinear)
+{
+	avg.assign(nbins, 0.0);
+	hi.assign(nbins, 0.0);
+	lo.assign(nbins, 0.0);
+	filled.assign(nbins, 0);
+	alpha = time_constant > 1.0 ? 1.0 / time_constant : 1.0;
+	decay = ndecay > 0.0 ? ndecay : 0.0;
+	linear = nlinear;
+	decay_factor = std::pow(10.0, -decay / 10.0);
+}
+
+void ExponentialStats::get_range(size_t first, size_t last, double* navg, double* nmax, double* nmin) const
+{
+	for(size_t bin = first; bin < last; bin++)
+	{
+		if(!filled[bin])
+		{
+			continue;
+		}
+		navg[bin - first] = avg[bin];
+		nmax[bin - first] = hi[bin];
+		nmin[bin - first] = lo[bin];
+	}
+}
+
+ExponentialStats::ExponentialStats()
+{
+	alpha = 1.0;
+	decay = 0.0;
+	linear = false;
+	decay_factor = 1.0;
+}
+
+template class RunningStats<float>;
+template class RunningStats<double>;
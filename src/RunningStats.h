@@ -0,0 +1,135 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "AlignedBuffer.h"
+
+// Sliding window average, maximum and minimum over the last `history` values
+// pushed to each bin, in amortized O(1) per value regardless of history length.
+// The average uses a running sum, and the maximum / minimum monotonic deques of
+// the slots of candidate values, so nothing is rescanned on every push.
+//
+// All history lives in a single arena, one tile per bin holding its values followed
+// by its two deques, so a push only touches that bin's tile. Only the arena base is
+// cache line aligned: tiles are packed back to back with no padding, so a tile may
+// straddle cache lines and neighbouring bins may share one. Bins are pushed in
+// order, so the shared lines are still only loaded once.
+// Deque slots take 1, 2 or 4 bytes depending on the history length, so with float
+// samples each value costs 6 bytes (history up to 256) or 8 bytes (up to 65536),
+// and with double 10 or 12 bytes.
+template<typename Sample>
+class RunningStats
+{
+private:
+	size_t bins;
+	uint32_t history;
+	// Bytes per deque slot, the smallest that can index history values
+	size_t slot_bytes;
+	// Bytes per bin tile, rounded up to keep the next tile's samples aligned
+	size_t tile_size;
+	AlignedBuffer<unsigned char> arena;
+
+	// Per bin state. Next slot to write, values stored so far, and the
+	// start and length of both deques (which are rings of slots)
+	std::vector<double> sum;
+	std::vector<uint32_t> pos;
+	std::vector<uint32_t> filled;
+	std::vector<uint32_t> max_head, max_len;
+	std::vector<uint32_t> min_head, min_len;
+
+	Sample* values_of(size_t bin) { return (Sample*)(arena.data() + bin * tile_size); }
+	const Sample* values_of(size_t bin) const { return (const Sample*)(arena.data() + bin * tile_size); }
+	unsigned char* max_dq_of(size_t bin) { return (unsigned char*)(values_of(bin) + history); }
+	const unsigned char* max_dq_of(size_t bin) const { return (const unsigned char*)(values_of(bin) + history); }
+	unsigned char* min_dq_of(size_t bin) { return max_dq_of(bin) + history * slot_bytes; }
+	const unsigned char* min_dq_of(size_t bin) const { return max_dq_of(bin) + history * slot_bytes; }
+
+	uint32_t get_slot(const unsigned char* dq, uint32_t idx) const
+	{
+		if(slot_bytes == 1)
+			return dq[idx];
+		if(slot_bytes == 2)
+			return ((const uint16_t*)dq)[idx];
+		return ((const uint32_t*)dq)[idx];
+	}
+	void set_slot(unsigned char* dq, uint32_t idx, uint32_t slot)
+	{
+		if(slot_bytes == 1)
+			dq[idx] = slot;
+		else if(slot_bytes == 2)
+			((uint16_t*)dq)[idx] = slot;
+		else
+			((uint32_t*)dq)[idx] = slot;
+	}
+
+	uint32_t wrap(uint32_t idx) const { return idx >= history ? idx - history : idx; }
+	void recompute_sum(size_t bin);
+
+public:
+
+	// Clears everything
+	void resize(size_t nbins, size_t nhistory);
+
+	void push(size_t bin, double value);
+
+	size_t count(size_t bin) const { return filled[bin]; }
+	double average(size_t bin) const { return sum[bin] / filled[bin]; }
+	double max(size_t bin) const { return values_of(bin)[get_slot(max_dq_of(bin), max_head[bin])]; }
+	double min(size_t bin) const { return values_of(bin)[get_slot(min_dq_of(bin), min_head[bin])]; }
+
+	// Writes the statistics of bins [first, last) to the arrays, which start at bin first.
+	// Bins without any value are left untouched.
+	void get_range(size_t first, size_t last, double* avg, double* max, double* min) const;
+
+	size_t get_history() const { return history; }
+	size_t get_bins() const { return bins; }
+	size_t get_memory_use() const { return arena.size(); }
+
+	RunningStats();
+};
+
+// Exponential moving average plus peak / valley hold decaying at a constant rate,
+// an alternative to RunningStats using O(bins) memory whatever the time constant
+class ExponentialStats
+{
+private:
+	std::vector<double> avg;
+	std::vector<double> hi;
+	std::vector<double> lo;
+	std::vector<uint8_t> filled;
+	double alpha;
+	double decay;
+	// In linear mode peaks decay by a factor instead, decay_factor = 10^(-decay / 10)
+	bool linear;
+	double decay_factor;
+
+public:
+
+	// Clears everything. time_constant is in values per bin, decay in dB per value.
+	// If nlinear, values are linear powers instead of dB.
+	void resize(size_t nbins, double time_constant, double ndecay, bool nlinear);
+
+	void push(size_t bin, double value)
+	{
+		if(!filled[bin])
+		{
+			avg[bin] = hi[bin] = lo[bin] = value;
+			filled[bin] = 1;
+			return;
+		}
+		avg[bin] += alpha * (value - avg[bin]);
+		double decayed_hi = linear ? hi[bin] * decay_factor : hi[bin] - decay;
+		double decayed_lo = linear ? lo[bin] / decay_factor : lo[bin] + decay;
+		hi[bin] = value > decayed_hi ? value : decayed_hi;
+		lo[bin] = value < decayed_lo ? value : decayed_lo;
+	}
+
+	bool has_value(size_t bin) const { return filled[bin]; }
+
+	// Same as RunningStats::get_range
+	void get_range(size_t first, size_t last, double* avg, double* max, double* min) const;
+
+	size_t get_memory_use() const { return avg.size() * (3 * sizeof(double) + 1); }
+
+	ExponentialStats();
+};
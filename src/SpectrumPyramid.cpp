@@ -0,0 +1,90 @@
+#include "SpectrumPyramid.h"
+#include <algorithm>
+
+void SpectrumPyramid::resize(size_t n)
+{
+	if(n == num && !offsets.empty())
+	{
+		return;
+	}
+
+	num = n;
+	offsets.clear();
+	size_t total = 0;
+	for(size_t level = 0; n > 1 && get_level_size(level) > 0; level++)
+	{
+		offsets.push_back(total);
+		total += get_level_size(level);
+		if(get_level_size(level) == 1)
+		{
+			break;
+		}
+	}
+	lo.assign(total, 0.0f);
+	hi.assign(total, 0.0f);
+}
+
+void SpectrumPyramid::update(const double* y, size_t first, size_t last)
+{
+	last = std::min(last, num);
+	if(first >= last || offsets.empty())
+	{
+		return;
+	}
+
+	// Entries of level 0 covering the changed bins
+	size_t f = first / 2;
+	size_t l = (last - 1) / 2 + 1;
+	float* dlo = lo.data() + offsets[0];
+	float* dhi = hi.data() + offsets[0];
+	for(size_t i = f; i < l; i++)
+	{
+		size_t b = 2 * i;
+		double vmin = y[b];
+		double vmax = y[b];
+		if(b + 1 < num)
+		{
+			vmin = std::min(vmin, y[b + 1]);
+			vmax = std::max(vmax, y[b + 1]);
+		}
+		dlo[i] = (float)vmin;
+		dhi[i] = (float)vmax;
+	}
+
+	// Every other level only depends on the changed entries of the one below
+	for(size_t level = 1; level < offsets.size(); level++)
+	{
+		const float* slo = lo.data() + offsets[level - 1];
+		const float* shi = hi.data() + offsets[level - 1];
+		size_t src_size = get_level_size(level - 1);
+		dlo = lo.data() + offsets[level];
+		dhi = hi.data() + offsets[level];
+
+		f = f / 2;
+		l = (l - 1) / 2 + 1;
+		for(size_t i = f; i < l; i++)
+		{
+			size_t s = 2 * i;
+			float vmin = slo[s];
+			float vmax = shi[s];
+			if(s + 1 < src_size)
+			{
+				vmin = std::min(vmin, slo[s + 1]);
+				vmax = std::max(vmax, shi[s + 1]);
+			}
+			dlo[i] = vmin;
+			dhi[i] = vmax;
+		}
+	}
+}
+
+void SpectrumPyramid::rebuild(const std::vector<double>& y)
+{
+	resize(y.size());
+	update(y.data(), 0, y.size());
+}
+
+SpectrumPyramid::SpectrumPyramid()
+{
+	num = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Min / max reductions of a series by 2, 4, 8... bins, so any zoom level can
+// be drawn from a level with a few entries per pixel instead of the raw bins.
+// Levels are kept up to date incrementally from the range of bins that changed.
+class SpectrumPyramid
+{
+private:
+	size_t num;
+	// Level k reduces 2^(k+1) bins, its entries start at offsets[k]. All levels
+	// together are about as long as the series.
+	std::vector<size_t> offsets;
+	std::vector<float> lo;
+	std::vector<float> hi;
+
+public:
+
+	// Only reallocates if n changed, call update() for the whole series afterwards
+	void resize(size_t n);
+	// y must have size() values, bins [first, last) changed
+	void update(const double* y, size_t first, size_t last);
+	void rebuild(const std::vector<double>& y);
+
+	size_t size() const { return num; }
+	size_t get_num_levels() const { return offsets.size(); }
+	// Bins reduced by each entry of the level
+	size_t get_factor(size_t level) const { return size_t(2) << level; }
+	size_t get_level_size(size_t level) const { return (num + get_factor(level) - 1) / get_factor(level); }
+	const float* get_lo(size_t level) const { return lo.data() + offsets[level]; }
+	const float* get_hi(size_t level) const { return hi.data() + offsets[level]; }
+
+	SpectrumPyramid();
+};
@@ -0,0 +1,274 @@
+#include "SpectrumSource.h"
+#include "RTLPowerWrapper.h"
+#include "RTLSDREngine.h"
+#include "ReplaySource.h"
+#include "SyntheticSource.h"
+#include <algorithm>
+#include <cmath>
+
+bool RTLPowerConfig::same_parameters(const RTLPowerConfig& b) const
+{
+	return nbins == b.nbins && overlap_percent == b.overlap_percent && use_stime == b.use_stime &&
+		(use_stime ? stime == b.stime : snum == b.snum) && gain == b.gain && samp_rate == b.samp_rate &&
+		device == b.device && command == b.command && binary == b.binary && continuous == b.continuous && iq_file == b.iq_file &&
+		replay_file == b.replay_file && tones == b.tones && hop_rate == b.hop_rate;
+}
+
+size_t RTLPowerConfig::get_num_hops() const
+{
+	double span = (double)max_f - (double)min_f;
+	double step = get_hop_step();
+	if(span <= samp_rate || step <= 0.0)
+	{
+		return 1;
+	}
+	return (size_t)std::ceil((span - samp_rate) / step) + 1;
+}
+
+void SpectrumSource::set_freq_range(uint64_t min, uint64_t max)
+{
+	next.min_f = min;
+	next.max_f = max;
+}
+
+void SpectrumSource::set_num_bins(int bins)
+{
+	next.nbins = bins;
+}
+
+void SpectrumSource::set_overlap(int percent)
+{
+	next.overlap_percent = percent;
+}
+
+void SpectrumSource::set_num_samples(int nsamples)
+{
+	next.snum = nsamples;
+	next.use_stime = false;
+}
+
+double SpectrumSource::set_samp_time(double nstime)
+{
+	next.stime = nstime;
+	next.use_stime = true;
+	return 0;
+}
+
+void SpectrumSource::set_gain(int ngain)
+{
+	next.gain = ngain;
+}
+
+void SpectrumSource::set_sample_rate(int rate)
+{
+	next.samp_rate = rate;
+}
+
+void SpectrumSource::set_binary(bool nbinary)
+{
+	next.binary = nbinary;
+}
+
+void SpectrumSource::set_device(const std::string& ndevice)
+{
+	next.device = ndevice;
+}
+
+void SpectrumSource::set_continuous(bool ncontinuous)
+{
+	next.continuous = ncontinuous;
+}
+
+void SpectrumSource::set_data_notify(std::condition_variable* cv)
+{
+	data_notify = cv;
+}
+
+void SpectrumSource::push_back_buffer(bool wait)
+{
+	// Sources which don't stamp their input only account the time queued
+	back_buffer.done_time = std::chrono::steady_clock::now();
+	if(back_buffer.read_time == std::chrono::steady_clock::time_point())
+	{
+		back_buffer.read_time = back_buffer.done_time;
+	}
+
+	// On success we get back the storage of an already consumed hop.
+	// Otherwise the hop is lost and counted as dropped.
+	while(wait && thread_run && hops.full())
+	{
+		data_notify->notify_one();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if(hops.push_swap(back_buffer))
+	{
+		data_notify->notify_one();
+	}
+
+	back_buffer.reads.clear();
+	back_buffer.is_end_of_sweep = false;
+	back_buffer.read_time = std::chrono::steady_clock::time_point();
+}
+
+void SpectrumSource::process_text_line(std::string_view line)
+{
+	if(line[0] == '#')
+	{
+		return;
+	}
+
+	if(line == "\n")
+	{
+		if(skipped_prev)
+		{
+			// End of sweep, notify with flag, and do nothing else
+			back_buffer.is_end_of_sweep = true;
+		}
+		skipped_prev = true;
+	}
+	else
+	{
+		if(skipped_prev)
+		{
+			// A spectrum was obtained last call
+			publish_back_buffer();
+			skipped_prev = false;
+		}
+
+		// Format is frequency [Hz] as scientific notation number
+		// followed by a space and then spectral density dB/Hz (arbitrarily referenced)
+		Readout read{};
+		if(parse_readout(line, read))
+		{
+			if(back_buffer.reads.empty())
+			{
+				back_buffer.read_time = text_read_time;
+			}
+			if(back_buffer.reads.size() == back_buffer.reads.capacity())
+			{
+				allocations++;
+			}
+			back_buffer.reads.push_back(read);
+		}
+	}
+}
+
+void SpectrumSource::end_text()
+{
+	// The last hop isn't followed by another one which would publish it
+	if(!back_buffer.reads.empty())
+	{
+		publish_back_buffer();
+	}
+	skipped_prev = false;
+}
+
+void SpectrumSource::pace(double hops_per_second)
+{
+	if(hops_per_second <= 0.0)
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	pace_next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / hops_per_second));
+	// If we fell far behind, don't burst to catch up
+	if(now - pace_next > std::chrono::seconds(1))
+	{
+		pace_next = now;
+	}
+	// In slices so stopping doesn't wait for slow rates
+	while(thread_run && now < pace_next)
+	{
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pace_next - now, std::chrono::milliseconds(100)));
+		now = std::chrono::steady_clock::now();
+	}
+}
+
+void SpectrumSource::reserve_reads(std::vector<Readout>& reads, size_t n)
+{
+	if(reads.capacity() < n)
+	{
+		reads.reserve(n);
+		allocations++;
+	}
+}
+
+bool SpectrumSource::wait_for_data(std::chrono::milliseconds timeout)
+{
+	// The producer notifies without locking, a missed wake up only costs one timeout
+	std::unique_lock<std::mutex> lock(data_mtx);
+	return data_available.wait_for(lock, timeout, [this]() { return !hops.empty(); });
+}
+
+bool SpectrumSource::can_keep_running()
+{
+	if(!thread_run || !running.continuous || !running.same_parameters(next))
+	{
+		return false;
+	}
+	if(next.min_f < running.min_f || next.max_f > running.max_f)
+	{
+		return false;
+	}
+
+	// Otherwise readouts fall between the bins of the new range
+	double offset = (next.min_f - running.min_f) / running.get_hertz_per_bin();
+	if(std::abs(offset - std::round(offset)) >= 1e-3)
+	{
+		return false;
+	}
+
+	// Not worth sweeping mostly hops that get thrown away
+	return next.get_num_hops() * 2 >= running.get_num_hops();
+}
+
+size_t SpectrumSource::get_hop_size()
+{
+	return running.nbins;
+}
+
+void SpectrumSource::reserve_hops()
+{
+	// Hop storage is allocated once here and then circulates through the queue
+	size_t hop_size = get_hop_size();
+	reserve_reads(back_buffer.reads, hop_size);
+	hops.for_each_slot([this, hop_size](RTLPowerData& slot)
+	{
+		reserve_reads(slot.reads, hop_size);
+	});
+}
+
+void SpectrumSource::stop()
+{
+	request_stop();
+	while(!reap())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+std::unique_ptr<SpectrumSource> SpectrumSource::create(SourceKind kind)
+{
+	switch(kind)
+	{
+	case SourceKind::direct:
+		return std::make_unique<RTLSDREngine>();
+	case SourceKind::replay:
+		return std::make_unique<ReplaySource>();
+	case SourceKind::synthetic:
+		return std::make_unique<SyntheticSource>();
+	default:
+		return std::make_unique<RTLPowerWrapper>();
+	}
+}
+
+SpectrumSource::SpectrumSource() : hops(64)
+{
+	thread_run = false;
+	skipped_prev = false;
+	allocations = 0;
+	back_buffer.is_end_of_sweep = false;
+	data_notify = &data_available;
+}
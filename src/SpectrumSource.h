@@ -0,0 +1,187 @@
+#pragma once
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include "ReadoutParser.h"
+#include "SpscRing.h"
+
+// Parameters of a run, named after rtl_power_fftw's options
+struct RTLPowerConfig
+{
+	// In Hertz
+	uint64_t min_f = 0, max_f = 0;
+	int nbins = 0;
+	int overlap_percent = 0;
+
+	bool use_stime = false;
+	double stime = 0.0;
+	// Tenths of dB
+	int gain = 0;
+	int snum = 0;
+	int samp_rate = 2e6;
+	// rtl_power_fftw -d argument, index or serial. Empty for the default device.
+	std::string device;
+	// Program (and leading arguments) run in place of rtl_power_fftw, which must
+	// take the same options, for example the rtl_power_loadgen stress generator
+	std::string command = "rtl_power_fftw";
+	// Read float32 sweeps from rtl_power_fftw's matrix output instead of text
+	bool binary = false;
+	// Sweep until stopped, otherwise a single sweep after which the worker ends
+	bool continuous = true;
+	// In-process engine only: unsigned 8 bit IQ (as written by rtl_sdr) to use
+	// instead of a device. Empty to capture from the device.
+	std::string iq_file;
+	// Replay source only: rtl_power_fftw text output, or a .bin/.met pair
+	std::string replay_file;
+	// Synthetic source only: frequencies of the tones, in Hertz
+	std::vector<uint64_t> tones;
+	// Replay and synthetic sources only: hops per second, 0 for as fast as the
+	// consumer takes them (these never drop hops)
+	double hop_rate = 0.0;
+
+	// Everything but the frequency range matches
+	bool same_parameters(const RTLPowerConfig& b) const;
+	double get_hertz_per_bin() const { return (double)samp_rate / (double)nbins; }
+	// Hops are laid out like rtl_power_fftw's: each one spans samp_rate, the
+	// first starts at min_f and consecutive ones overlap by overlap_percent
+	double get_hop_step() const { return samp_rate * (1.0 - overlap_percent / 100.0); }
+	size_t get_num_hops() const;
+	double get_hop_center(size_t hop) const { return min_f + samp_rate / 2.0 + hop * get_hop_step(); }
+};
+
+struct RTLPowerData
+{
+	bool is_end_of_sweep = false;
+	std::vector<Readout> reads;
+	// When its first input was read and when it was complete, for latency statistics
+	std::chrono::steady_clock::time_point read_time;
+	std::chrono::steady_clock::time_point done_time;
+};
+
+enum class SourceKind
+{
+	// rtl_power_fftw child process, see RTLPowerWrapper
+	rtl_power_fftw,
+	// librtlsdr + FFTW in this process, see RTLSDREngine
+	direct,
+	// Recorded output played back, see ReplaySource
+	replay,
+	// Generated noise and tones, see SyntheticSource
+	synthetic
+};
+
+// Produces hops of readouts in its own thread, which a single consumer
+// thread pops from hops. Implementations run rtl_power_fftw or capture
+// and transform in process, configured with the same parameters.
+class SpectrumSource
+{
+protected:
+
+	// Parameters of the next launch, and of the running one
+	RTLPowerConfig next;
+	RTLPowerConfig running;
+
+	std::thread thread;
+	std::atomic<bool> thread_run;
+
+	// Hop being assembled by the worker thread
+	RTLPowerData back_buffer;
+	// Queues back_buffer and clears it. If wait, blocks while the queue is full
+	// (until stopped) instead of dropping the hop.
+	void push_back_buffer(bool wait);
+	// Hands a completed hop over, by default dropping it if the consumer is behind
+	virtual void publish_back_buffer() { push_back_buffer(false); }
+
+	// Assembles hops out of rtl_power_fftw's text output, one line at a time.
+	// Call end_text at the end of the stream, which publishes the last hop.
+	// Set text_read_time when reading, it's stamped on the hops the lines start.
+	bool skipped_prev;
+	std::chrono::steady_clock::time_point text_read_time;
+	void process_text_line(std::string_view line);
+	void end_text();
+
+	// Sleeps so hops are published at most hops_per_second (no limit if 0).
+	// Call pace_start before the first hop.
+	std::chrono::steady_clock::time_point pace_next;
+	void pace_start() { pace_next = std::chrono::steady_clock::now(); }
+	void pace(double hops_per_second);
+
+	// Readouts expected in a single hop, used to preallocate hop storage
+	virtual size_t get_hop_size();
+	void reserve_reads(std::vector<Readout>& reads, size_t n);
+	// Call from launch, before the worker thread starts
+	void reserve_hops();
+	std::atomic<uint64_t> allocations;
+
+	std::condition_variable* data_notify;
+
+public:
+
+	virtual SourceKind get_kind() = 0;
+
+	// Also preallocates the storage of queued hops, so call it from the consumer
+	// thread (or while nothing is being consumed). Must be reaped.
+	virtual void launch() = 0;
+	// Asks the run to end and returns right away, then reap() it
+	virtual void request_stop() = 0;
+	// Without blocking, returns true once everything of the last run is gone
+	virtual bool reap() = 0;
+	// Blocks until the run is gone
+	void stop();
+
+	// The following only take effect on the next launch
+	void set_config(const RTLPowerConfig& config) { next = config; }
+	void set_freq_range(uint64_t min, uint64_t max);
+	void set_num_bins(int nbins);
+	void set_overlap(int percent);
+	void set_num_samples(int nsamples);
+	double set_samp_time(double stime);
+	void set_gain(int ngain);
+	void set_sample_rate(int rate);
+	void set_binary(bool binary);
+	void set_device(const std::string& ndevice);
+	void set_continuous(bool ncontinuous);
+
+	// The running one already produces everything the next launch would:
+	// same parameters, a range containing the new one and on the same bin grid.
+	// Bins outside the new range are then simply ignored by the consumer.
+	// Keeping it avoids reopening the device, but it goes on sweeping its whole
+	// range, so it's only kept while the new range needs at least half of its
+	// hops. Narrowing further restarts it to get the faster sweeps.
+	bool can_keep_running();
+	// Also true once the run ended by itself, call stop() before launching again
+	bool is_stopped() { return !thread_run; }
+
+	// True if not running
+	virtual bool get_exec_status() = 0;
+
+	// Throughput of the input, to see if it's the bottleneck
+	virtual double get_bytes_per_second() = 0;
+	virtual double get_lines_per_second() = 0;
+	// Number of times hop storage had to be (re)allocated, should stay flat while running
+	uint64_t get_allocations() { return allocations; }
+
+	// Completed hops, pop_swap them from a single consumer thread. If the consumer
+	// is too slow hops are dropped, see hops.get_dropped()
+	SpscRing<RTLPowerData> hops;
+
+	// Blocks until a hop is queued or the timeout expires, returns true if
+	// there's data. data_mtx is only used for sleeping, never to pass data.
+	bool wait_for_data(std::chrono::milliseconds timeout);
+	std::condition_variable data_available;
+	std::mutex data_mtx;
+	// Notify cv instead of data_available, so a consumer of several sources can
+	// sleep on a single condition variable. wait_for_data won't wake up then.
+	void set_data_notify(std::condition_variable* cv);
+
+	static std::unique_ptr<SpectrumSource> create(SourceKind kind);
+
+	SpectrumSource();
+	// Implementations must stop() and join their thread in their destructor
+	virtual ~SpectrumSource() = default;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue of preallocated slots.
+// Items are swapped in and out, so the producer gets back the storage of an
+// already consumed item and nothing is copied nor allocated while running.
+// If the consumer falls behind, new items are dropped and counted.
+template<typename T>
+class SpscRing
+{
+private:
+	std::vector<T> slots;
+
+	// Monotonic counters, slot index is counter % capacity
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+	std::atomic<uint64_t> pushed;
+	std::atomic<uint64_t> dropped;
+	std::atomic<size_t> high_water;
+
+public:
+
+	// Producer side. Swaps item into the queue, item receives the storage of
+	// a previously consumed slot. Returns false (and leaves item untouched) if full.
+	bool push_swap(T& item);
+	// Consumer side. Swaps the oldest item out, item's old storage goes back
+	// into the slot for the producer to reuse. Returns false if empty.
+	bool pop_swap(T& item);
+
+	bool empty() const { return size() == 0; }
+	bool full() const { return size() == capacity(); }
+	// Safe from any thread: head is loaded first, so the tail is never older than it
+	// and the difference can't wrap. It can only overshoot if items were popped
+	// meanwhile, hence the clamp.
+	size_t size() const
+	{
+		size_t h = head.load(std::memory_order_acquire);
+		size_t t = tail.load(std::memory_order_acquire);
+		return std::min(t - h, capacity());
+	}
+	size_t capacity() const { return slots.size(); }
+
+	uint64_t get_pushed() const { return pushed; }
+	uint64_t get_dropped() const { return dropped; }
+	// Maximum fill level seen, close to capacity means the consumer is too slow
+	size_t get_high_water() const { return high_water; }
+
+	// Only while nobody pushes or pops, for example to preallocate storage
+	template<typename F>
+	void for_each_slot(F&& f) { for(T& slot : slots) f(slot); }
+
+	explicit SpscRing(size_t capacity);
+};
+
+template<typename T>
+SpscRing<T>::SpscRing(size_t capacity) : slots(capacity)
+{
+	head = 0;
+	tail = 0;
+	pushed = 0;
+	dropped = 0;
+	high_water = 0;
+}
+
+template<typename T>
+bool SpscRing<T>::push_swap(T& item)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+	size_t h = head.load(std::memory_order_acquire);
+	if(t - h == slots.size())
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	std::swap(slots[t % slots.size()], item);
+	tail.store(t + 1, std::memory_order_release);
+
+	pushed.fetch_add(1, std::memory_order_relaxed);
+	if(t + 1 - h > high_water.load(std::memory_order_relaxed))
+	{
+		high_water.store(t + 1 - h, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+template<typename T>
+bool SpscRing<T>::pop_swap(T& item)
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	size_t t = tail.load(std::memory_order_acquire);
+	if(h == t)
+	{
+		return false;
+	}
+
+	std::swap(item, slots[h % slots.size()]);
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
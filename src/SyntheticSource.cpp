@@ -0,0 +1,121 @@
+#include "SyntheticSource.h"
+#include <algorithm>
+#include <cmath>
+
+void SyntheticSource::launch()
+{
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+
+	running = next;
+	rng.seed(1);
+	noise = std::normal_distribution<double>(noise_floor, noise_sigma);
+	back_buffer.reads.clear();
+	back_buffer.is_end_of_sweep = false;
+	reserve_hops();
+	rates.reset();
+
+	finished = false;
+	thread_run = true;
+	thread = std::thread([this]()
+	{
+		run();
+	});
+}
+
+void SyntheticSource::request_stop()
+{
+	thread_run = false;
+}
+
+bool SyntheticSource::reap()
+{
+	if(!thread.joinable())
+	{
+		return true;
+	}
+	if(!finished)
+	{
+		return false;
+	}
+	thread.join();
+	return true;
+}
+
+void SyntheticSource::run()
+{
+	size_t nhops = running.get_num_hops();
+	pace_start();
+	do
+	{
+		for(size_t h = 0; h < nhops && thread_run; h++)
+		{
+			pace(running.hop_rate);
+			generate_hop(running.get_hop_center(h));
+			back_buffer.is_end_of_sweep = h + 1 == nhops;
+			publish_back_buffer();
+		}
+	} while(thread_run && running.continuous);
+
+	thread_run = false;
+	finished = true;
+	data_notify->notify_one();
+}
+
+void SyntheticSource::generate_hop(double center)
+{
+	size_t n = running.nbins;
+	double hertz_per_bin = running.get_hertz_per_bin();
+	double low = center - running.samp_rate / 2.0;
+	back_buffer.read_time = std::chrono::steady_clock::now();
+
+	reserve_reads(back_buffer.reads, n);
+	back_buffer.reads.resize(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		back_buffer.reads[i].freq = low + i * hertz_per_bin;
+		back_buffer.reads[i].power = noise(rng);
+	}
+
+	// Roughly the main lobe of a windowed FFT, so tones also show between bins
+	for(uint64_t tone : running.tones)
+	{
+		double pos = (tone - low) / hertz_per_bin;
+		long k = std::lround(pos);
+		for(long i = k - 1; i <= k + 1; i++)
+		{
+			if(i < 0 || i >= (long)n)
+			{
+				continue;
+			}
+			double dist = std::abs(pos - i);
+			double power = tone_power - 6.0 * dist * dist;
+			back_buffer.reads[i].power = std::max(back_buffer.reads[i].power, power);
+		}
+	}
+
+	rates.update(n * sizeof(Readout), n);
+}
+
+void SyntheticSource::publish_back_buffer()
+{
+	push_back_buffer(true);
+}
+
+SyntheticSource::SyntheticSource()
+{
+	finished = true;
+}
+
+SyntheticSource::~SyntheticSource()
+{
+	stop();
+	if(thread.joinable())
+	{
+		thread_run = false;
+		thread.join();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <random>
+#include "SpectrumSource.h"
+#include "RateMeter.h"
+
+// Generates hops of noise with a few constant tones, laid out like
+// rtl_power_fftw's, to load the pipeline at a known rate without hardware.
+// Seeded the same way on every launch so runs are reproducible. Like the
+// replay source, hops wait for the consumer instead of being dropped.
+class SyntheticSource : public SpectrumSource
+{
+private:
+
+	static constexpr double noise_floor = -60.0;
+	static constexpr double noise_sigma = 1.0;
+	static constexpr double tone_power = -20.0;
+
+	std::minstd_rand rng;
+	std::normal_distribution<double> noise;
+
+	// The worker thread ended and can be joined
+	std::atomic<bool> finished;
+	RateMeter rates;
+
+	void run();
+	void generate_hop(double center);
+
+	void publish_back_buffer() override;
+
+public:
+
+	SourceKind get_kind() override { return SourceKind::synthetic; }
+
+	void launch() override;
+	void request_stop() override;
+	bool reap() override;
+
+	bool get_exec_status() override { return !thread_run; }
+
+	// Readouts produced, bytes being their in memory size
+	double get_bytes_per_second() override { return rates.bytes_per_second; }
+	double get_lines_per_second() override { return rates.lines_per_second; }
+
+	SyntheticSource();
+	~SyntheticSource();
+};
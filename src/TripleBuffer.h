@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Lets a writer thread publish complete copies of some state which a reader
+// thread picks up whenever it wants, neither of them ever waits for the other.
+// The reader only sees the newest published value, intermediate ones are skipped.
+template<typename T>
+class TripleBuffer
+{
+private:
+	T slots[3];
+	static constexpr int dirty_bit = 4;
+	// Slot last published, with dirty_bit set if the reader didn't take it yet
+	std::atomic<int> ready;
+	// Owned by the writer and the reader respectively
+	int back;
+	int front;
+
+public:
+
+	// Writer side. Fill this (it holds stale data from a few publishes ago, so
+	// assign to it to reuse its storage) and then publish()
+	T& get_back() { return slots[back]; }
+	void publish()
+	{
+		back = ready.exchange(back | dirty_bit, std::memory_order_acq_rel) & ~dirty_bit;
+	}
+
+	// Reader side. If something new was published, swaps it into out and returns true.
+	bool consume(T& out)
+	{
+		if(!(ready.load(std::memory_order_acquire) & dirty_bit))
+		{
+			return false;
+		}
+		front = ready.exchange(front, std::memory_order_acq_rel) & ~dirty_bit;
+		std::swap(out, slots[front]);
+		return true;
+	}
+
+	TripleBuffer()
+	{
+		back = 0;
+		ready = 1;
+		front = 2;
+	}
+};
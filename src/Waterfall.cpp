@@ -0,0 +1,64 @@
+#include "Waterfall.h"
+#include <algorithm>
+#include <cstring>
+
+void Waterfall::resize(size_t nbins, size_t nrows)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	bins = nbins;
+	rows = nrows;
+	width = std::min(bins, max_width);
+	data.assign(rows * width, 0.0f);
+	head = 0;
+	generation++;
+}
+
+void Waterfall::append(const double* spectrum, size_t n)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if(rows == 0 || width == 0)
+	{
+		return;
+	}
+
+	n = std::min(n, bins);
+	float* row = data.data() + (head % rows) * width;
+	for(size_t c = 0; c < width; c++)
+	{
+		size_t first = c * n / width;
+		size_t last = std::max((c + 1) * n / width, first + 1);
+		double v = spectrum[first];
+		for(size_t i = first + 1; i < last && i < n; i++)
+		{
+			v = std::max(v, spectrum[i]);
+		}
+		row[c] = (float)v;
+	}
+	head++;
+}
+
+Waterfall::Info Waterfall::get_info()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return Info{generation, head, rows, width};
+}
+
+bool Waterfall::read_row(uint64_t ngeneration, uint64_t seq, float* out)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if(ngeneration != generation || seq >= head || seq + rows < head)
+	{
+		return false;
+	}
+	std::memcpy(out, data.data() + (seq % rows) * width, width * sizeof(float));
+	return true;
+}
+
+Waterfall::Waterfall()
+{
+	rows = 0;
+	width = 0;
+	bins = 0;
+	head = 0;
+	generation = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Ring of the last few sweeps for the waterfall view, float32 and row-major.
+// Rows are appended in place (never shifted) by the worker thread, and the GUI
+// copies out the ones it didn't see yet. Wide sweeps are reduced to at most
+// max_width columns, keeping the maximum of each group of bins so narrow
+// signals don't vanish.
+class Waterfall
+{
+private:
+	std::mutex mtx;
+	size_t rows;
+	size_t width;
+	size_t bins;
+	std::vector<float> data;
+	// Rows ever appended, row n lives at n % rows
+	uint64_t head;
+	// Changes every resize, so readers know their copy is stale
+	uint64_t generation;
+
+public:
+	static constexpr size_t default_rows = 1024;
+	static constexpr size_t max_width = 4096;
+
+	struct Info
+	{
+		uint64_t generation;
+		uint64_t head;
+		size_t rows;
+		size_t width;
+	};
+
+	// Clears everything
+	void resize(size_t nbins, size_t nrows);
+	void append(const double* spectrum, size_t n);
+
+	Info get_info();
+	// Copies row number seq (width floats). Returns false if it's not available
+	// anymore, or the waterfall was resized since generation.
+	bool read_row(uint64_t ngeneration, uint64_t seq, float* out);
+
+	Waterfall();
+};
@@ -0,0 +1,309 @@
+// Stands in for rtl_power_fftw to stress rtlpowergui at a known rate without hardware.
+// Takes the same options rtlpowergui passes to rtl_power_fftw (so it can be set as
+// the command to run) and writes the same output: text hops separated by a blank
+// line with a second blank line ending each sweep, or the -m matrix.
+// The spectrum is a noise floor with constant and drifting tones, from a fixed seed.
+//
+// Own options:
+//	--rate N			bins per second to write, 0 (default) for as fast as possible
+//	--floor DB			noise floor, -60 by default
+//	--noise DB			standard deviation of the noise, 1 by default
+//	--tone MHZ[:DB]		constant tone, repeatable
+//	--drift MHZ:HZ_S[:DB]	tone starting at MHZ moving HZ_S Hertz per second, wrapping
+//						around the range, repeatable
+//	--sweeps N			stop after N sweeps even with -c
+//	--seed N
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Tone
+{
+	double freq;
+	// Hertz per second
+	double drift;
+	double power;
+};
+
+struct Options
+{
+	double min_f = 0.0, max_f = 0.0;
+	int nbins = 512;
+	int overlap_percent = 0;
+	double samp_rate = 2e6;
+	bool continuous = false;
+	std::string matrix_basename;
+
+	double bins_per_second = 0.0;
+	double floor = -60.0;
+	double noise = 1.0;
+	std::vector<Tone> tones;
+	long sweeps = -1;
+	unsigned seed = 1;
+};
+
+static void usage()
+{
+	std::cerr << "Usage: rtl_power_loadgen -f MIN:MAX [-b BINS] [-o OVERLAP] [-r RATE] [-c] [-m BASENAME]\n"
+			  << "       [--rate BINS_PER_S] [--floor DB] [--noise DB] [--tone MHZ[:DB]]...\n"
+			  << "       [--drift MHZ:HZ_PER_S[:DB]]... [--sweeps N] [--seed N]\n"
+			  << "Other rtl_power_fftw options (-g, -n, -t, -d) are accepted and ignored." << std::endl;
+}
+
+// "a:b[:c]" into up to three numbers, returns how many were read
+static int parse_fields(const char* str, double* out, int max)
+{
+	int n = 0;
+	while(n < max)
+	{
+		char* end;
+		out[n] = std::strtod(str, &end);
+		if(end == str)
+			break;
+		n++;
+		if(*end != ':')
+			break;
+		str = end + 1;
+	}
+	return n;
+}
+
+static bool parse_options(int argc, char** argv, Options& opt)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		const char* value = has_value ? argv[i + 1] : "";
+		double f[3];
+
+		if(arg == "-c")
+		{
+			opt.continuous = true;
+			continue;
+		}
+		if(!has_value)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		i++;
+
+		if(arg == "-f")
+		{
+			if(parse_fields(value, f, 2) != 2)
+				return false;
+			opt.min_f = f[0];
+			opt.max_f = f[1];
+		}
+		else if(arg == "-b")
+			opt.nbins = std::atoi(value);
+		else if(arg == "-o")
+			opt.overlap_percent = std::atoi(value);
+		else if(arg == "-r")
+			opt.samp_rate = std::atof(value);
+		else if(arg == "-m")
+			opt.matrix_basename = value;
+		else if(arg == "-g" || arg == "-n" || arg == "-t" || arg == "-d")
+			continue;
+		else if(arg == "--rate")
+			opt.bins_per_second = std::atof(value);
+		else if(arg == "--floor")
+			opt.floor = std::atof(value);
+		else if(arg == "--noise")
+			opt.noise = std::atof(value);
+		else if(arg == "--tone" || arg == "--drift")
+		{
+			bool drift = arg == "--drift";
+			f[2] = -20.0;
+			int n = parse_fields(value, f, 3);
+			if(n < (drift ? 2 : 1))
+				return false;
+			Tone tone;
+			tone.freq = f[0] * 1e6;
+			tone.drift = drift ? f[1] : 0.0;
+			tone.power = drift ? f[2] : (n > 1 ? f[1] : -20.0);
+			opt.tones.push_back(tone);
+		}
+		else if(arg == "--sweeps")
+			opt.sweeps = std::atol(value);
+		else if(arg == "--seed")
+			opt.seed = std::atoi(value);
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	return opt.max_f > opt.min_f && opt.nbins > 0 && opt.samp_rate > 0.0;
+}
+
+class Generator
+{
+private:
+	const Options& opt;
+	std::minstd_rand rng;
+	std::normal_distribution<double> noise;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	// Powers of one hop starting at low, tones placed at their position at time t
+	void hop(double low, double t, float* out)
+	{
+		double hertz_per_bin = opt.samp_rate / opt.nbins;
+		for(int i = 0; i < opt.nbins; i++)
+		{
+			out[i] = noise(rng);
+		}
+
+		double span = opt.max_f - opt.min_f;
+		for(const Tone& tone : opt.tones)
+		{
+			double freq = tone.freq + tone.drift * t;
+			if(tone.drift != 0.0)
+			{
+				freq = opt.min_f + std::fmod(std::fmod(freq - opt.min_f, span) + span, span);
+			}
+
+			// Roughly the main lobe of a windowed FFT
+			double pos = (freq - low) / hertz_per_bin;
+			long k = std::lround(pos);
+			for(long i = k - 1; i <= k + 1; i++)
+			{
+				if(i < 0 || i >= opt.nbins)
+					continue;
+				double dist = std::abs(pos - i);
+				out[i] = std::max(out[i], (float)(tone.power - 6.0 * dist * dist));
+			}
+		}
+	}
+
+	double elapsed()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Sleeps until written bins are due at the requested rate
+	void pace(double bins_written)
+	{
+		if(opt.bins_per_second <= 0.0)
+			return;
+		double due = bins_written / opt.bins_per_second;
+		double now = elapsed();
+		if(due > now)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(due - now));
+		}
+	}
+
+	explicit Generator(const Options& o) : opt(o), rng(o.seed), noise(o.floor, o.noise)
+	{
+		start = std::chrono::steady_clock::now();
+	}
+};
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	if(!parse_options(argc, argv, opt))
+	{
+		usage();
+		return 1;
+	}
+
+	// Same hop layout as rtl_power_fftw: each hop spans the sample rate, the
+	// first one starts at the bottom of the range and they overlap by -o percent
+	double step = opt.samp_rate * (1.0 - opt.overlap_percent / 100.0);
+	double span = opt.max_f - opt.min_f;
+	size_t nhops = 1;
+	if(span > opt.samp_rate && step > 0.0)
+	{
+		nhops = (size_t)std::ceil((span - opt.samp_rate) / step) + 1;
+	}
+	double hertz_per_bin = opt.samp_rate / opt.nbins;
+
+	FILE* out = stdout;
+	size_t matrix_columns = 0;
+	std::vector<float> row;
+	if(!opt.matrix_basename.empty())
+	{
+		// Whole sweeps as float32 rows, every hop's bins in turn like rtl_power_fftw
+		out = std::fopen((opt.matrix_basename + ".bin").c_str(), "wb");
+		if(!out)
+		{
+			std::cerr << "Unable to open " << opt.matrix_basename << ".bin" << std::endl;
+			return 1;
+		}
+		matrix_columns = nhops * opt.nbins;
+		row.resize(matrix_columns);
+	}
+
+	static char outbuf[1 << 20];
+	std::setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+
+	Generator gen(opt);
+	std::vector<float> powers(opt.nbins);
+	std::vector<char> text;
+	double bins_written = 0.0;
+	long sweeps = opt.continuous ? opt.sweeps : 1;
+	for(long sweep = 0; sweeps < 0 || sweep < sweeps; sweep++)
+	{
+		for(size_t h = 0; h < nhops; h++)
+		{
+			double low = opt.min_f + h * step;
+			gen.hop(low, gen.elapsed(), powers.data());
+
+			if(matrix_columns > 0)
+			{
+				std::copy(powers.begin(), powers.end(), row.begin() + h * opt.nbins);
+			}
+			else
+			{
+				// One write per hop, formatted like rtl_power_fftw's output
+				text.clear();
+				const char* header = "# rtl-power-fftw output\n# frequency [Hz] power spectral density [dB/Hz]\n";
+				text.insert(text.end(), header, header + std::strlen(header));
+				char line[64];
+				for(int i = 0; i < opt.nbins; i++)
+				{
+					int len = std::snprintf(line, sizeof(line), "%.6e %.3f\n", low + i * hertz_per_bin, powers[i]);
+					text.insert(text.end(), line, line + len);
+				}
+				text.push_back('\n');
+				if(h + 1 == nhops)
+				{
+					text.push_back('\n');
+				}
+				std::fwrite(text.data(), 1, text.size(), out);
+			}
+
+			bins_written += opt.nbins;
+			if(h + 1 == nhops && matrix_columns > 0)
+			{
+				std::fwrite(row.data(), sizeof(float), row.size(), out);
+			}
+			std::fflush(out);
+			if(std::ferror(out))
+			{
+				// The reader went away
+				return 0;
+			}
+			gen.pace(bins_written);
+		}
+	}
+
+	if(out != stdout)
+	{
+		std::fclose(out);
+	}
+	return 0;
+}